@@ -0,0 +1,512 @@
+// Microbenchmarks for the frame core: loading a frame file, measuring line
+// widths, generating an interpolated frame and drawing into a headless
+// screen, over a synthetic corpus of frame sizes and character mixes.
+//
+// Results are printed as a table and, with --json, written as JSON. Passing
+// a previous JSON file with --baseline compares against it and exits with
+// status 1 if any benchmark got slower than the tolerance allows. Before
+// timing anything it checks that frames decoded from a keyframe store
+// dissolve exactly like the loaded frames, and exits with status 1 if not.
+
+#include "animator.h"
+#include "config.h"
+#include "frame.h"
+#include "frame_store.h"
+#include "headless_renderer.h"
+#include "random.h"
+#include "transitions.h"
+
+#include <algorithm>
+#include <chrono>
+#include <clocale> // For setlocale
+#include <climits> // For MB_LEN_MAX
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h> // For getpid
+
+namespace {
+
+enum class Mix { ascii, cjk, emoji, mixed };
+
+const char* mix_name(Mix mix) {
+    switch (mix) {
+        case Mix::ascii: return "ascii";
+        case Mix::cjk: return "cjk";
+        case Mix::emoji: return "emoji";
+        case Mix::mixed: return "mixed";
+    }
+    return "?";
+}
+
+Mix parse_mix(const std::string& name) {
+    for (Mix mix : {Mix::ascii, Mix::cjk, Mix::emoji, Mix::mixed}) {
+        if (name == mix_name(mix)) {
+            return mix;
+        }
+    }
+    throw std::runtime_error("Unknown character mix: " + name + " (expected ascii, cjk, emoji or mixed)");
+}
+
+struct CorpusSize {
+    int cols;
+    int rows;
+};
+
+CorpusSize parse_size(const std::string& text) {
+    CorpusSize size{};
+    char separator = 0;
+    std::istringstream in(text);
+    if (!(in >> size.cols >> separator >> size.rows) || separator != 'x' || size.cols < 2 || size.rows < 1) {
+        throw std::runtime_error("Invalid frame size: " + text + " (expected COLSxROWS, e.g. 80x24)");
+    }
+    return size;
+}
+
+std::vector<std::string> split_list(const std::string& text) {
+    std::vector<std::string> items;
+    std::istringstream in(text);
+    for (std::string item; std::getline(in, item, ',');) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Glyph pools, each with its display width.
+struct Glyph {
+    std::string_view utf8;
+    int width;
+};
+
+constexpr Glyph kAsciiGlyphs[] = {
+    {" ", 1}, {".", 1}, {":", 1}, {"-", 1}, {"=", 1}, {"+", 1}, {"*", 1}, {"#", 1},
+    {"%", 1}, {"@", 1}, {"o", 1}, {"O", 1}, {"/", 1}, {"\\", 1}, {"|", 1}, {"_", 1},
+};
+constexpr Glyph kCjkGlyphs[] = {
+    {"漢", 2}, {"字", 2}, {"日", 2}, {"本", 2}, {"語", 2}, {"中", 2}, {"文", 2}, {"한", 2},
+};
+constexpr Glyph kEmojiGlyphs[] = {
+    {"😀", 2}, {"🎉", 2}, {"🚀", 2}, {"🌟", 2}, {"🔥", 2}, {"🍕", 2}, {"🐍", 2}, {"🌈", 2},
+};
+// Multi-codepoint clusters, which go through the grapheme table.
+constexpr Glyph kClusterGlyphs[] = {
+    {"👩‍💻", 2}, {"👨‍👩‍👧", 2}, {"é", 1}, {"ñ", 1},
+};
+
+template <size_t N>
+const Glyph& pick(const Glyph (&pool)[N], std::uint64_t random) {
+    return pool[random % N];
+}
+
+// The glyph at one position of a line: a pure function of `key`, so a corpus
+// is the same on every run.
+const Glyph& pick_glyph(Mix mix, std::uint64_t key) {
+    std::uint64_t random = mix64(key);
+    std::uint64_t choice = random >> 32;
+    switch (mix) {
+        case Mix::ascii: return pick(kAsciiGlyphs, random);
+        case Mix::cjk: return choice % 8 == 0 ? pick(kAsciiGlyphs, random) : pick(kCjkGlyphs, random);
+        case Mix::emoji: return choice % 8 == 0 ? pick(kAsciiGlyphs, random) : pick(kEmojiGlyphs, random);
+        case Mix::mixed:
+            switch (choice % 20) {
+                case 0: return pick(kClusterGlyphs, random);
+                case 1: case 2: case 3: case 4: return pick(kEmojiGlyphs, random);
+                case 5: case 6: case 7: case 8: case 9: return pick(kCjkGlyphs, random);
+                default: return pick(kAsciiGlyphs, random);
+            }
+    }
+    return kAsciiGlyphs[0];
+}
+
+// One frame of text exactly `size.cols` columns wide and `size.rows` lines high.
+std::vector<std::string> make_frame_text(Mix mix, CorpusSize size, std::uint64_t key) {
+    std::vector<std::string> lines(size.rows);
+    for (int y = 0; y < size.rows; ++y) {
+        std::string& line = lines[y];
+        std::uint64_t line_key = derive_key(key, y);
+        int width = 0;
+        for (int i = 0; width < size.cols; ++i) {
+            const Glyph& glyph = pick_glyph(mix, derive_key(line_key, i));
+            if (width + glyph.width > size.cols) {
+                line += ' ';
+                ++width;
+                continue;
+            }
+            line += glyph.utf8;
+            width += glyph.width;
+        }
+    }
+    return lines;
+}
+
+void write_frame_file(const std::filesystem::path& path, const std::vector<std::string>& lines) {
+    std::ofstream out(path, std::ios::binary);
+    for (const auto& line : lines) {
+        out << line << '\n';
+    }
+    if (!out) {
+        throw std::runtime_error("Could not write corpus file " + path.string());
+    }
+}
+
+// The corpus for one size and mix: two different frames, as text and as files.
+struct Case {
+    std::string label; // mix/COLSxROWS
+    CorpusSize size;
+    std::vector<std::string> start_text;
+    std::vector<std::string> end_text;
+    std::string start_path;
+    std::string end_path;
+};
+
+struct Result {
+    std::string name;
+    double ns_per_op = 0;
+    double ns_per_cell = 0;
+    std::uint64_t iterations = 0;
+};
+
+// Runs `op` in growing batches until one batch takes at least `min_time`,
+// then times `samples` batches of that size and keeps the median, which
+// shrugs off the odd slow batch from scheduling noise.
+Result measure(const std::string& name, std::uint64_t cells, std::chrono::nanoseconds min_time, int samples,
+               const std::function<void()>& op) {
+    using bench_clock = std::chrono::steady_clock;
+    auto time_batch = [&](std::uint64_t count) {
+        auto start = bench_clock::now();
+        for (std::uint64_t i = 0; i < count; ++i) {
+            op();
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start);
+    };
+
+    std::uint64_t batch = 1;
+    while (true) {
+        auto elapsed = time_batch(batch);
+        if (elapsed >= min_time) {
+            break;
+        }
+        // Aim straight for the target with some margin, at most 10x at a time.
+        double scale = elapsed.count() > 0 ? 1.2 * min_time.count() / elapsed.count() : 10.0;
+        batch = std::max(batch + 1, static_cast<std::uint64_t>(batch * std::min(scale, 10.0)));
+    }
+
+    std::vector<double> per_op;
+    for (int i = 0; i < samples; ++i) {
+        per_op.push_back(static_cast<double>(time_batch(batch).count()) / batch);
+    }
+    std::sort(per_op.begin(), per_op.end());
+
+    Result result;
+    result.name = name;
+    result.ns_per_op = per_op[per_op.size() / 2];
+    result.ns_per_cell = cells > 0 ? result.ns_per_op / cells : 0.0;
+    result.iterations = batch * static_cast<std::uint64_t>(samples);
+    return result;
+}
+
+// Keeps the optimizer from dropping work whose result is otherwise unused.
+volatile std::uint64_t sink = 0;
+
+void write_json(std::ostream& out, const std::vector<Result>& results) {
+    out << std::fixed << std::setprecision(3) << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        // One benchmark per line, which read_baseline relies on.
+        out << (i > 0 ? "," : "") << "\n    {\"name\": \"" << result.name << "\""
+            << ", \"ns_per_op\": " << result.ns_per_op
+            << ", \"ns_per_cell\": " << result.ns_per_cell
+            << ", \"iterations\": " << result.iterations << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// Reads the ns_per_op of every benchmark in a file written by write_json.
+std::map<std::string, double> read_baseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Could not read baseline " + path);
+    }
+    constexpr std::string_view kName = "\"name\": \"";
+    constexpr std::string_view kTime = "\"ns_per_op\": ";
+    std::map<std::string, double> baseline;
+    for (std::string line; std::getline(in, line);) {
+        size_t name_at = line.find(kName);
+        size_t time_at = line.find(kTime);
+        if (name_at == std::string::npos || time_at == std::string::npos) {
+            continue;
+        }
+        name_at += kName.size();
+        size_t name_end = line.find('"', name_at);
+        if (name_end == std::string::npos) {
+            continue;
+        }
+        baseline[line.substr(name_at, name_end - name_at)] = std::strtod(line.c_str() + time_at + kTime.size(), nullptr);
+    }
+    if (baseline.empty()) {
+        throw std::runtime_error("No benchmarks found in baseline " + path);
+    }
+    return baseline;
+}
+
+// Prints how each result compares with the baseline. Returns the number of
+// benchmarks more than `tolerance` (a fraction) slower than their baseline.
+int compare_with_baseline(std::ostream& out, const std::vector<Result>& results,
+                          const std::map<std::string, double>& baseline, double tolerance) {
+    int regressions = 0;
+    out << "\n" << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "baseline ns"
+        << std::setw(14) << "current ns" << std::setw(10) << "change" << "\n";
+    for (const Result& result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0) {
+            continue;
+        }
+        double change = result.ns_per_op / it->second - 1.0;
+        bool regressed = change > tolerance;
+        regressions += regressed ? 1 : 0;
+        out << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << it->second << std::setw(14) << result.ns_per_op
+            << std::setw(9) << std::showpos << change * 100.0 << std::noshowpos << "%"
+            << (regressed ? "  REGRESSION" : "") << "\n";
+    }
+    return regressions;
+}
+
+std::vector<Result> run_case(const Case& bench_case, const std::string& filter, std::chrono::nanoseconds min_time,
+                             int samples, int threads) {
+    std::vector<Result> results;
+    std::uint64_t cells = static_cast<std::uint64_t>(bench_case.size.cols) * bench_case.size.rows;
+    auto wanted = [&](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+
+    // Reading and decoding a frame file, as at startup and on every streamed frame.
+    std::string name = "load/" + bench_case.label;
+    if (wanted(name)) {
+        results.push_back(measure(name, cells, min_time, samples, [&] {
+            Frame frame(bench_case.start_path);
+            sink = sink + static_cast<std::uint64_t>(frame.get_width());
+        }));
+    }
+
+    // Decoding lines into cells and measuring their display width, without the file.
+    name = "width/" + bench_case.label;
+    if (wanted(name)) {
+        std::vector<Cell> scratch;
+        results.push_back(measure(name, cells, min_time, samples, [&] {
+            int total = 0;
+            for (const auto& line : bench_case.start_text) {
+                scratch.clear();
+                total += decode_utf8_line(line, scratch);
+            }
+            sink = sink + static_cast<std::uint64_t>(total);
+        }));
+    }
+
+    name = "interpolate/" + bench_case.label;
+    std::string draw_name = "draw/" + bench_case.label;
+    if (!wanted(name) && !wanted(draw_name)) {
+        return results;
+    }
+
+    Config config;
+    config.frame_paths = {bench_case.start_path, bench_case.end_path};
+    config.threads = threads;
+    config.seed = 1;
+    Animator animator(config);
+    auto start = animator.get_frame(0);
+    auto end = animator.get_frame(1);
+
+    // One dissolve step, cycling through the steps of a 30-step segment.
+    constexpr int kSteps = 30;
+    if (wanted(name)) {
+        int step = 0;
+        results.push_back(measure(name, cells, min_time, samples, [&] {
+            step = step % (kSteps - 1) + 1;
+            Frame frame = animator.generate_interpolated_frame(*start, *end, step, kSteps);
+            sink = sink + static_cast<std::uint64_t>(frame.get_height());
+        }));
+    }
+
+    // Full redraws into an in-memory screen, alternating between the two frames.
+    if (wanted(draw_name)) {
+        HeadlessRenderer renderer(bench_case.size.rows, bench_case.size.cols);
+        bool flip = false;
+        results.push_back(measure(draw_name, cells, min_time, samples, [&] {
+            flip = !flip;
+            renderer.draw_frame(flip ? *end : *start);
+        }));
+        sink = sink + renderer.get_cells_written();
+    }
+    return results;
+}
+
+// An ASCII frame followed by the same frame with one CJK line is stored as a
+// keyframe and a delta, so its wide glyphs only arrive through the delta.
+// Returns true if every step of a dissolve into the decoded frame matches the
+// dissolve into the frame loaded from its file.
+bool check_stored_dissolve(const std::filesystem::path& corpus_dir, int threads) {
+    constexpr CorpusSize kSize{80, 24};
+    std::vector<std::string> plain_text = make_frame_text(Mix::ascii, kSize, 1);
+    std::vector<std::string> wide_text = plain_text;
+    wide_text.back() = make_frame_text(Mix::cjk, {kSize.cols, 1}, 2).front();
+    std::string plain_path = (corpus_dir / "check_plain.txt").string();
+    std::string wide_path = (corpus_dir / "check_wide.txt").string();
+    write_frame_file(plain_path, plain_text);
+    write_frame_file(wide_path, wide_text);
+
+    Config config;
+    config.frame_paths = {plain_path, wide_path};
+    config.threads = threads;
+    config.seed = 1;
+    Animator loaded(config);
+    config.keyframe_interval = kDefaultKeyframeInterval;
+    Animator stored(config);
+
+    constexpr int kSteps = 30;
+    auto loaded_start = loaded.get_frame(0);
+    auto loaded_end = loaded.get_frame(1);
+    auto stored_start = stored.get_frame(0);
+    auto stored_end = stored.get_frame(1);
+    for (int step = 1; step < kSteps; ++step) {
+        Frame expected = loaded.generate_interpolated_frame(*loaded_start, *loaded_end, step, kSteps);
+        Frame actual = stored.generate_interpolated_frame(*stored_start, *stored_end, step, kSteps);
+        if (!actual.has_same_content(expected)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void print_result(std::ostream& out, const Result& result) {
+    out << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(14) << result.ns_per_op << std::setprecision(3) << std::setw(12) << result.ns_per_cell
+        << std::setw(12) << result.iterations << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // Widths of wide glyphs come from the locale, as in `frame` itself. Fall
+    // back to a UTF-8 locale so the corpus decodes the same wherever it runs.
+    std::setlocale(LC_ALL, "");
+    if (MB_CUR_MAX == 1 && std::setlocale(LC_ALL, "C.UTF-8") == nullptr) {
+        std::cerr << "Warning: no UTF-8 locale; wide glyphs will be measured as one column." << std::endl;
+    }
+
+    cxxopts::Options options("frame_bench", "Microbenchmarks for frame loading, width measurement, interpolation and drawing");
+    options.add_options()
+        ("sizes", "Frame sizes as COLSxROWS, comma-separated", cxxopts::value<std::string>()->default_value("80x24,200x60,400x120,1000x300"))
+        ("mixes", "Character mixes (ascii, cjk, emoji, mixed), comma-separated", cxxopts::value<std::string>()->default_value("ascii,cjk,emoji,mixed"))
+        ("filter", "Only run benchmarks whose name contains this text", cxxopts::value<std::string>()->default_value(""))
+        ("min-time", "Minimum time in ms for each timed batch", cxxopts::value<int>()->default_value("50"))
+        ("samples", "Timed batches per benchmark; the median is reported", cxxopts::value<int>()->default_value("5"))
+        ("j,threads", "Worker threads for interpolation (0 = one per core)", cxxopts::value<int>()->default_value("1"))
+        ("json", "Write the results to FILE as JSON", cxxopts::value<std::string>())
+        ("baseline", "Compare with a JSON file from an earlier --json run", cxxopts::value<std::string>())
+        ("tolerance", "Slowdown in percent allowed before a benchmark counts as a regression", cxxopts::value<double>()->default_value("10"))
+        ("corpus", "Write the corpus to this directory and keep it, instead of a temporary one", cxxopts::value<std::string>())
+        ("h,help", "Print usage");
+
+    try {
+        auto args = options.parse(argc, argv);
+        if (args.count("help")) {
+            std::cout << options.help() << std::endl;
+            return 0;
+        }
+
+        std::vector<CorpusSize> sizes;
+        for (const auto& text : split_list(args["sizes"].as<std::string>())) {
+            sizes.push_back(parse_size(text));
+        }
+        std::vector<Mix> mixes;
+        for (const auto& text : split_list(args["mixes"].as<std::string>())) {
+            mixes.push_back(parse_mix(text));
+        }
+        auto min_time = std::chrono::milliseconds(std::max(1, args["min-time"].as<int>()));
+        int samples = std::max(1, args["samples"].as<int>());
+        int threads = args["threads"].as<int>();
+        std::string filter = args["filter"].as<std::string>();
+
+        // Read the baseline first, so a bad path fails before the long run.
+        std::map<std::string, double> baseline;
+        if (args.count("baseline")) {
+            baseline = read_baseline(args["baseline"].as<std::string>());
+        }
+
+        bool keep_corpus = args.count("corpus") > 0;
+        std::filesystem::path corpus_dir = keep_corpus
+            ? std::filesystem::path(args["corpus"].as<std::string>())
+            : std::filesystem::temp_directory_path() / ("frame_bench." + std::to_string(getpid()));
+        std::filesystem::create_directories(corpus_dir);
+
+        if (!check_stored_dissolve(corpus_dir, threads)) {
+            std::cerr << "Error: a frame decoded from a keyframe store dissolves differently from the loaded frame"
+                      << std::endl;
+            if (!keep_corpus) {
+                std::filesystem::remove_all(corpus_dir);
+            }
+            return 1;
+        }
+
+        std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "ns/op"
+                  << std::setw(12) << "ns/cell" << std::setw(12) << "iterations" << std::endl;
+        std::vector<Result> results;
+        for (Mix mix : mixes) {
+            for (CorpusSize size : sizes) {
+                Case bench_case;
+                bench_case.size = size;
+                bench_case.label = std::string(mix_name(mix)) + "/" + std::to_string(size.cols) + "x" +
+                                   std::to_string(size.rows);
+                std::uint64_t key = derive_key(static_cast<std::uint64_t>(mix), (static_cast<std::uint64_t>(size.cols) << 32) | size.rows);
+                bench_case.start_text = make_frame_text(mix, size, derive_key(key, 0));
+                bench_case.end_text = make_frame_text(mix, size, derive_key(key, 1));
+                std::string stem = std::string(mix_name(mix)) + "_" + std::to_string(size.cols) + "x" + std::to_string(size.rows);
+                bench_case.start_path = (corpus_dir / (stem + "_start.txt")).string();
+                bench_case.end_path = (corpus_dir / (stem + "_end.txt")).string();
+                write_frame_file(bench_case.start_path, bench_case.start_text);
+                write_frame_file(bench_case.end_path, bench_case.end_text);
+
+                for (const Result& result : run_case(bench_case, filter, min_time, samples, threads)) {
+                    print_result(std::cout, result);
+                    results.push_back(result);
+                }
+            }
+        }
+
+        if (!keep_corpus) {
+            std::filesystem::remove_all(corpus_dir);
+        }
+
+        if (args.count("json")) {
+            std::string path = args["json"].as<std::string>();
+            std::ofstream out(path);
+            write_json(out, results);
+            if (!out) {
+                throw std::runtime_error("Could not write " + path);
+            }
+        }
+
+        if (!baseline.empty()) {
+            double tolerance = args["tolerance"].as<double>() / 100.0;
+            int regressions = compare_with_baseline(std::cout, results, baseline, tolerance);
+            if (regressions > 0) {
+                std::cout << regressions << " benchmark(s) regressed by more than "
+                          << args["tolerance"].as<double>() << "%" << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
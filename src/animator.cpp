@@ -1,108 +1,249 @@
 #include "animator.h"
 #include "config.h"
+#include "frame_store.h"
+#include "frame_stream.h"
+#include "random.h"
+#include "thread_pool.h"
+#include "transitions.h"
 #include <stdexcept>
 #include <algorithm>
-#include <cmath>
-#include <cstdlib> // For mblen, srand, rand
-#include <ctime>   // For time
-#include <clocale> // For setlocale
-
-Animator::Animator(const Config& config) {
-    // Set the global C locale from the user's environment.
-    // This is necessary for mblen to correctly interpret multi-byte UTF-8 characters.
-    std::setlocale(LC_ALL, "");
+#include <cstdint>
+#include <random>
+#include <unordered_map>
 
+Animator::Animator(const Config& config, const Animator* previous)
+    : frame_paths(config.frame_paths), keyframe_interval(config.keyframe_interval) {
     if (config.frame_paths.empty()) {
         throw std::runtime_error("Animator requires at least one frame path.");
     }
 
-    for (const auto& path : config.frame_paths) {
-        frames.emplace_back(path);
+    // Without a seed every run dissolves differently; with one, runs are reproducible.
+    seed = config.seed ? *config.seed : std::random_device{}();
+
+    pool = std::make_unique<ThreadPool>(resolve_thread_count(config.threads));
+
+    // Reuses a frame the previous animator already read from the same file.
+    auto load = [&](size_t i) {
+        if (previous != nullptr) {
+            if (auto loaded = previous->find_loaded(config.frame_paths[i])) {
+                return loaded;
+            }
+        }
+        return std::make_shared<const Frame>(config.frame_paths[i]);
+    };
+
+    size_t count = config.frame_paths.size();
+    if (config.stream_window > 0) {
+        // Long flip-books are loaded in the background as playback reaches them.
+        size_t memory_cap = static_cast<size_t>(config.stream_memory_mb) * 1024 * 1024;
+        stream = std::make_unique<FrameStream>(config.frame_paths, config.stream_window, memory_cap, config.loop);
+    } else if (config.keyframe_interval > 0) {
+        // Frames are read in parallel a batch at a time and encoded in order,
+        // so only one batch is ever held whole.
+        store = std::make_unique<FrameStore>(config.keyframe_interval);
+        size_t batch_size = static_cast<size_t>(pool->size()) * 2;
+        std::vector<std::shared_ptr<const Frame>> batch;
+        for (size_t first = 0; first < count; first += batch_size) {
+            batch.assign(std::min(batch_size, count - first), nullptr);
+            pool->parallel_for(batch.size(), [&](size_t i) { batch[i] = load(first + i); });
+            for (const auto& frame : batch) {
+                store->append(*frame);
+            }
+        }
+        store->finish();
+    } else {
+        // A path listed several times is read once.
+        std::unordered_map<std::string, size_t> by_path;
+        std::vector<size_t> first_index; // Index of each distinct path's first use
+        std::vector<size_t> distinct(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto [it, inserted] = by_path.try_emplace(config.frame_paths[i], first_index.size());
+            if (inserted) {
+                first_index.push_back(i);
+            }
+            distinct[i] = it->second;
+        }
+
+        // Frame files are independent, so they are read, decoded and hashed in parallel.
+        std::vector<std::shared_ptr<const Frame>> loaded(first_index.size());
+        std::vector<std::uint64_t> hashes(first_index.size());
+        pool->parallel_for(loaded.size(), [&](size_t i) {
+            loaded[i] = load(first_index[i]);
+            hashes[i] = loaded[i]->get_content_hash();
+        });
+
+        // Different files with the same content share one frame as well.
+        std::unordered_map<std::uint64_t, std::vector<std::shared_ptr<const Frame>>> by_content;
+        for (size_t i = 0; i < loaded.size(); ++i) {
+            auto& same_hash = by_content[hashes[i]];
+            auto match = std::find_if(same_hash.begin(), same_hash.end(),
+                                      [&](const auto& frame) { return frame->has_same_content(*loaded[i]); });
+            if (match != same_hash.end()) {
+                loaded[i] = *match;
+            } else {
+                same_hash.push_back(loaded[i]);
+            }
+        }
+
+        frames.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            frames[i] = loaded[distinct[i]];
+        }
     }
+}
 
-    // Seed the random number generator once for the entire animation session.
-    srand(time(NULL));
+std::shared_ptr<const Frame> Animator::find_loaded(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(frames_mutex);
+    for (size_t i = 0; i < frame_paths.size(); ++i) {
+        if (frame_paths[i] != path) {
+            continue;
+        }
+        if (store) {
+            return store->get(static_cast<int>(i));
+        }
+        if (i < frames.size()) {
+            return frames[i];
+        }
+    }
+    return nullptr;
 }
 
-const Frame& Animator::get_frame(int index) const {
-    if (index < 0 || index >= frames.size()) {
+bool Animator::reload_frame(const std::string& path) {
+    bool found = false;
+    std::shared_ptr<const Frame> reloaded;
+    for (size_t i = 0; i < frame_paths.size(); ++i) {
+        if (frame_paths[i] != path) {
+            continue;
+        }
+        found = true;
+        if (stream) {
+            stream->reload(static_cast<int>(i));
+            continue;
+        }
+        // A path listed several times is parsed once and shared.
+        if (!reloaded) {
+            auto frame = std::make_shared<Frame>();
+            if (!frame->load_from_file(path)) {
+                return found; // Unreadable for now (e.g. deleted); keep the old frame.
+            }
+            reloaded = std::move(frame);
+        }
+        if (!store) {
+            std::lock_guard<std::mutex> lock(frames_mutex);
+            frames[i] = reloaded;
+        }
+    }
+    // Deltas chain from frame to frame, so an edited frame means encoding
+    // the sequence again.
+    if (store && reloaded) {
+        auto rebuilt = std::make_unique<FrameStore>(keyframe_interval);
+        for (size_t i = 0; i < frame_paths.size(); ++i) {
+            rebuilt->append(frame_paths[i] == path ? *reloaded : *store->get(static_cast<int>(i)));
+        }
+        rebuilt->finish();
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        store = std::move(rebuilt);
+    }
+    return found;
+}
+
+Animator::~Animator() = default;
+
+std::shared_ptr<const Frame> Animator::get_frame(int index) const {
+    if (index < 0 || index >= get_frame_count()) {
         throw std::out_of_range("Frame index out of range.");
     }
+    if (stream) {
+        return stream->get(index);
+    }
+    std::lock_guard<std::mutex> lock(frames_mutex);
+    if (store) {
+        return store->get(index);
+    }
     return frames[index];
 }
 
 int Animator::get_frame_count() const {
-    return frames.size();
+    if (stream) {
+        return stream->size();
+    }
+    return store ? store->size() : static_cast<int>(frames.size());
 }
 
 // Generates a new frame by interpolating between two source frames.
-// This function is stateless; it calculates the result based only on the inputs.
-Frame Animator::generate_interpolated_frame(const Frame& start_frame, const Frame& end_frame, int step, int total_steps) const {
-    // Progress is a value from 0.0 (fully start_frame) to 1.0 (fully end_frame).
-    float progress = (total_steps == 0) ? 1.0f : static_cast<float>(step) / total_steps;
-
-    const auto& start_pixels = start_frame.get_pixels();
-    const auto& end_pixels = end_frame.get_pixels();
-
-    // The new frame will have the maximum height of the two source frames.
-    int height = std::max(start_frame.get_height(), end_frame.get_height());
-
-    std::vector<std::string> new_pixels;
-    new_pixels.reserve(height);
-
-    for (int y = 0; y < height; ++y) {
-        // Get the corresponding line from each frame. If one frame is shorter, use an empty string.
-        const std::string& start_line = (y < start_pixels.size()) ? start_pixels[y] : "";
-        const std::string& end_line = (y < end_pixels.size()) ? end_pixels[y] : "";
-
-        std::string new_line;
-        
-        const char* p_start = start_line.c_str();
-        const char* p_end = end_line.c_str();
-        const char* const limit_start = p_start + start_line.length();
-        const char* const limit_end = p_end + end_line.length();
-
-        // Reset the multi-byte character state for each new line.
-        mblen(NULL, 0);
-
-        // This loop iterates through both lines simultaneously, character by character,
-        // correctly handling multi-byte UTF-8 characters.
-        while (p_start < limit_start || p_end < limit_end) {
-            // Get the next full character (grapheme) from the start line.
-            std::string char_start = " ";
-            if (p_start < limit_start) {
-                int len = mblen(p_start, limit_start - p_start);
-                if (len > 0) {
-                    char_start = std::string(p_start, len);
-                    p_start += len;
-                } else { // Invalid char or error, advance by 1 byte to avoid an infinite loop.
-                    p_start++;
-                }
-            }
+// This function is stateless; it calculates the result based only on the inputs,
+// so rows can be generated on any thread and the result is the same.
+Frame Animator::generate_interpolated_frame(const Frame& start_frame, const Frame& end_frame, int step, int total_steps,
+                                            int segment, Transition transition) const {
+    TransitionStep position;
+    position.seed = seed;
+    position.segment = segment;
+    position.step = step;
+    position.total_steps = total_steps;
+    return interpolate_frames(transition, start_frame, end_frame, position, *pool);
+}
 
-            // Get the next full character (grapheme) from the end line.
-            std::string char_end = " ";
-            if (p_end < limit_end) {
-                int len = mblen(p_end, limit_end - p_end);
-                if (len > 0) {
-                    char_end = std::string(p_end, len);
-                    p_end += len;
-                } else { // Invalid char or error, advance by 1 byte.
-                    p_end++;
-                }
+Dissolve::Dissolve(const Frame& start_frame, const Frame& end_frame, std::uint64_t key)
+    : start(start_frame),
+      end(end_frame),
+      frame(std::max(start_frame.get_width(), end_frame.get_width()),
+            std::max(start_frame.get_height(), end_frame.get_height())) {
+    for (int y = 0; y < frame.get_height(); ++y) {
+        LineView start_line = line_view(start, y);
+        LineView end_line = line_view(end, y);
+        int line_width = std::max(start_line.width, end_line.width);
+        Cell* out = frame.row(y);
+
+        for (int x = 0; x < line_width;) {
+            int span = unit_span(start_line, end_line, x, line_width);
+            bool differs = false;
+            for (int i = x; i < x + span; ++i) {
+                out[i] = start_line.at(i);
+                differs = differs || !(start_line.at(i) == end_line.at(i));
             }
-
-            // Implements a "dissolve" effect. The probability of choosing the
-            // end character increases with the animation's progress.
-            float random_threshold = static_cast<float>(rand()) / RAND_MAX;
-            if (random_threshold < progress) {
-                new_line += char_end;
-            } else {
-                new_line += char_start;
+            // Units that look the same in both frames never need to be touched.
+            if (differs) {
+                order.push_back({y, x, span});
             }
+            x += span;
         }
-        new_pixels.push_back(new_line);
+        frame.set_line_width(y, line_width);
     }
 
-    return Frame(new_pixels);
-}
\ No newline at end of file
+    // Fisher-Yates shuffle: a unit's position in `order` is its switch threshold.
+    // Each swap draws from the key and its position, so the order is reproducible.
+    for (size_t i = order.size(); i > 1; --i) {
+        size_t j = static_cast<size_t>(derive_key(key, i) % i);
+        std::swap(order[i - 1], order[j]);
+    }
+}
+
+const std::vector<CellUpdate>& Dissolve::advance(int step, int total_steps) {
+    changes.clear();
+
+    // The number of units that should show the end frame at this step.
+    size_t target = order.size();
+    if (total_steps > 0 && step < total_steps) {
+        target = order.size() * static_cast<size_t>(std::max(step, 0)) / total_steps;
+    }
+
+    // Normally the playhead only moves forward, but stepping back is handled
+    // by reverting units to the start frame in reverse order.
+    for (; switched < target; ++switched) {
+        apply_unit(order[switched], end);
+    }
+    for (; switched > target; --switched) {
+        apply_unit(order[switched - 1], start);
+    }
+
+    return changes;
+}
+
+void Dissolve::apply_unit(const Unit& unit, const Frame& source) {
+    LineView line = line_view(source, unit.y);
+    Cell* out = frame.row(unit.y);
+    for (int i = unit.x; i < unit.x + unit.span; ++i) {
+        out[i] = line.at(i);
+        changes.push_back({unit.y, i, out[i]});
+    }
+}
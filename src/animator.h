@@ -2,24 +2,93 @@
 #define FRAME_ANIMATOR_H
 
 #include "frame.h"
+#include "transitions.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
 struct Config;
+class FrameStore;
+class FrameStream;
+class ThreadPool;
 
 class Animator {
 public:
-    explicit Animator(const Config& config);
+    // Loads the frames named by `config`. Frames already loaded by `previous`
+    // from the same files are shared instead of being read again.
+    explicit Animator(const Config& config, const Animator* previous = nullptr);
+    ~Animator();
 
-    // Stateless method to generate an interpolated frame.
-    Frame generate_interpolated_frame(const Frame& start, const Frame& end, int step, int total_steps) const;
+    // Reads every frame loaded from `path` again and swaps the new version in.
+    // Holders of the old frame keep it until they ask for the frame again, so
+    // playback picks up the change the next time it reaches that frame.
+    // Returns false if no frame comes from `path`. If the file cannot be read
+    // the old frame is kept.
+    bool reload_frame(const std::string& path);
 
-    // Accessors for the loaded frames.
-    const Frame& get_frame(int index) const;
+    // Stateless method to generate an interpolated frame with the given effect.
+    // Random choices depend only on the seed, `segment`, `step` and the cell's
+    // position, so the same call always gives the same frame. Large frames use
+    // every worker thread.
+    Frame generate_interpolated_frame(const Frame& start, const Frame& end, int step, int total_steps, int segment = 0,
+                                      Transition transition = Transition::dissolve) const;
+
+    // The seed for this run's random choices.
+    std::uint64_t get_seed() const { return seed; }
+
+    // Accessors for the loaded frames. With streaming enabled, a frame is only
+    // guaranteed to stay in memory while the returned pointer is held.
+    std::shared_ptr<const Frame> get_frame(int index) const;
     int get_frame_count() const;
 
 private:
-    std::vector<Frame> frames;
+    // The loaded frame read from `path`, or null if there is none.
+    std::shared_ptr<const Frame> find_loaded(const std::string& path) const;
+
+    std::vector<std::string> frame_paths;
+    mutable std::mutex frames_mutex; // Guards `frames` against reloads during playback
+    std::vector<std::shared_ptr<const Frame>> frames;
+    std::unique_ptr<FrameStream> stream; // Set instead of `frames` when streaming
+    std::unique_ptr<FrameStore> store;   // Set instead of `frames` when keyframe_interval is set; guarded by frames_mutex
+    int keyframe_interval;
+    std::unique_ptr<ThreadPool> pool;
+    std::uint64_t seed;
+};
+
+// An incremental dissolve between two frames. Each transition unit gets a fixed
+// place in a shuffled switch order when the segment starts, so it flips from the
+// start glyph to the end glyph exactly once, and each step only touches the
+// cells whose turn has just come. Both source frames must outlive the Dissolve.
+class Dissolve {
+public:
+    // The shuffle is drawn from `key`, so the same key gives the same order.
+    Dissolve(const Frame& start_frame, const Frame& end_frame, std::uint64_t key);
+
+    // Moves the dissolve to `step` of `total_steps` and returns the cells that
+    // changed since the previous call. The list is reused by the next call.
+    const std::vector<CellUpdate>& advance(int step, int total_steps);
+
+    // The frame as of the last call to advance (the start frame before any call).
+    const Frame& current() const { return frame; }
+
+private:
+    // A run of columns that always switch together (see unit_span).
+    struct Unit {
+        int y;
+        int x;
+        int span;
+    };
+
+    void apply_unit(const Unit& unit, const Frame& source);
+
+    const Frame& start;
+    const Frame& end;
+    Frame frame;
+    std::vector<Unit> order; // Only the units where the two frames differ
+    size_t switched = 0;
+    std::vector<CellUpdate> changes;
 };
 
 #endif //FRAME_ANIMATOR_H
@@ -0,0 +1,280 @@
+#include "ansi_renderer.h"
+#include "frame.h"
+#include "stage_stats.h"
+#include <algorithm>
+#include <charconv>
+#include <iterator> // For std::size
+
+namespace {
+
+constexpr const char* kHideCursor = "\x1b[?25l";
+constexpr const char* kShowCursor = "\x1b[?25h";
+constexpr const char* kClearScreen = "\x1b[H\x1b[2J";
+constexpr const char* kResetAttributes = "\x1b[m";
+
+// SGR parameters for each style bit, in kStyle* order.
+constexpr int kStyleCodes[] = {1, 2, 3, 4, 5, 7, 9};
+
+void append_int(std::string& out, int value) {
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+int digit_count(int value) {
+    int count = 1;
+    for (; value >= 10; value /= 10) {
+        ++count;
+    }
+    return count;
+}
+
+// Appends ESC [ n <final>, leaving out a count of 1 since it is the default.
+void append_csi(std::string& out, int count, char final) {
+    out += "\x1b[";
+    if (count != 1) {
+        append_int(out, count);
+    }
+    out += final;
+}
+
+// ESC [ row ; col H, leaving out the defaults (row 1, column 1).
+int jump_sequence_length(int y, int x) {
+    int length = 3;
+    if (y > 0 || x > 0) {
+        length += digit_count(y + 1);
+    }
+    if (x > 0) {
+        length += 1 + digit_count(x + 1);
+    }
+    return length;
+}
+
+void append_jump(std::string& out, int y, int x) {
+    out += "\x1b[";
+    if (y > 0 || x > 0) {
+        append_int(out, y + 1);
+    }
+    if (x > 0) {
+        out += ';';
+        append_int(out, x + 1);
+    }
+    out += 'H';
+}
+
+} // namespace
+
+AnsiRenderer::AnsiRenderer(int rows, int cols)
+    : rows(rows), cols(cols), screen(static_cast<size_t>(rows) * cols, kBlankCell) {}
+
+void AnsiRenderer::resize(int new_rows, int new_cols) {
+    rows = new_rows;
+    cols = new_cols;
+    fixed_size = true;
+    screen.assign(static_cast<size_t>(rows) * cols, kBlankCell);
+    layout.clear();
+    cursor_y = -1;
+    cursor_x = -1;
+    // Room for a full redraw of multi-byte glyphs, so drawing never reallocates.
+    output.reserve(static_cast<size_t>(rows) * cols * 4 + static_cast<size_t>(rows) * 16);
+}
+
+void AnsiRenderer::clear_screen() {
+    output += kHideCursor;
+    // The screen is cleared to the current background, so that has to be the default.
+    reset_attributes();
+    output += kClearScreen;
+    std::fill(screen.begin(), screen.end(), kBlankCell);
+    layout.clear();
+    cursor_y = 0;
+    cursor_x = 0;
+}
+
+void AnsiRenderer::finish() {
+    reset_attributes();
+    output += kShowCursor;
+}
+
+void AnsiRenderer::reset_attributes() {
+    if (pen_known && pen.has_same_attributes(kBlankCell)) {
+        return;
+    }
+    output += kResetAttributes;
+    pen = kBlankCell;
+    pen_known = true;
+}
+
+void AnsiRenderer::set_attributes(const Cell& cell) {
+    if (pen_known && pen.has_same_attributes(cell)) {
+        return;
+    }
+    output += "\x1b[";
+    bool first = true;
+    auto append_param = [&](int value) {
+        if (!first) {
+            output += ';';
+        }
+        append_int(output, value);
+        first = false;
+    };
+    auto append_color = [&](int base, std::uint32_t color) {
+        if (color == kDefaultColor) {
+            append_param(base + 9);
+            return;
+        }
+        append_param(base + 8);
+        append_param(2);
+        append_param(static_cast<int>(color >> 16));
+        append_param(static_cast<int>((color >> 8) & 0xFF));
+        append_param(static_cast<int>(color & 0xFF));
+    };
+
+    // Styles can only be turned off one by one or all at once, so dropping
+    // any starts over from a reset.
+    if (!pen_known || (pen.style & ~cell.style) != 0) {
+        append_param(0);
+        pen = kBlankCell;
+    }
+    for (int bit = 0; bit < static_cast<int>(std::size(kStyleCodes)); ++bit) {
+        if ((cell.style & ~pen.style) & (1 << bit)) {
+            append_param(kStyleCodes[bit]);
+        }
+    }
+    if (cell.fg != pen.fg) {
+        append_color(30, cell.fg);
+    }
+    if (cell.bg != pen.bg) {
+        append_color(40, cell.bg);
+    }
+    output += 'm';
+    pen.style = cell.style;
+    pen.fg = cell.fg;
+    pen.bg = cell.bg;
+    pen_known = true;
+}
+
+void AnsiRenderer::move_to(int y, int x) {
+    if (y == cursor_y && x == cursor_x) {
+        return;
+    }
+
+    // Pick the shortest way there. An absolute jump always works; the
+    // relative moves only from a known position.
+    int jump_length = jump_sequence_length(y, x);
+    bool known = cursor_y >= 0 && cursor_x >= 0;
+    if (known && y == cursor_y && x > cursor_x) {
+        // Rewriting the cells in between, which are already known, is often
+        // shorter than any cursor movement.
+        int gap = x - cursor_x;
+        int step_length = gap == 1 ? 3 : 3 + digit_count(gap);
+        size_t limit = static_cast<size_t>(std::min(step_length, jump_length));
+        const Cell* row = screen.data() + static_cast<size_t>(y) * cols;
+        glyph_buffer.clear();
+        int i = cursor_x;
+        // Only cells already in the current colors can be rewritten as they are.
+        while (i < x && row[i].width > 0 && i + row[i].width <= x && glyph_buffer.size() < limit &&
+               pen_known && row[i].has_same_attributes(pen)) {
+            append_glyph_utf8(row[i].glyph, glyph_buffer);
+            i += row[i].width;
+        }
+        if (i == x && glyph_buffer.size() < limit) {
+            output += glyph_buffer;
+        } else if (step_length < jump_length) {
+            append_csi(output, gap, 'C');
+        } else {
+            append_jump(output, y, x);
+        }
+    } else if (known && x == 0 && y == cursor_y) {
+        output += '\r';
+    } else if (known && x == 0 && y == cursor_y + 1) {
+        output += "\r\n";
+    } else if (known && y == cursor_y && cursor_x < cols && 3 + digit_count(cursor_x - x) < jump_length) {
+        append_csi(output, cursor_x - x, 'D');
+    } else {
+        append_jump(output, y, x);
+    }
+    cursor_y = y;
+    cursor_x = x;
+}
+
+void AnsiRenderer::put_cell(int y, int x, const Cell& cell) {
+    Cell* row = screen.data() + static_cast<size_t>(y) * cols;
+    if (row[x] == cell) {
+        return;
+    }
+    row[x] = cell;
+    if (cell.width == 0) {
+        return; // Right half of a wide glyph, written with its left half.
+    }
+    move_to(y, x);
+    set_attributes(cell);
+    glyph_buffer.clear();
+    append_glyph_utf8(cell.glyph, glyph_buffer);
+    output += glyph_buffer;
+    cursor_x += cell.width;
+    if (cell.width == 2) {
+        row[x + 1] = {U' ', 0};
+    }
+}
+
+void AnsiRenderer::draw_frame(const Frame& frame) {
+    if (frame.get_height() == 0 || frame.get_width() == 0) {
+        return; // Don't attempt to draw an empty or unloaded frame
+    }
+    StageTimer timer(Stage::draw);
+
+    if (!fixed_size && (frame.get_height() > rows || frame.get_width() > cols)) {
+        rows = std::max(rows, frame.get_height());
+        cols = std::max(cols, frame.get_width());
+        screen.assign(static_cast<size_t>(rows) * cols, kBlankCell);
+        reset_attributes();
+        output += kClearScreen;
+        cursor_y = 0;
+        cursor_x = 0;
+        layout.clear();
+    }
+    if (!layout.matches(frame)) {
+        layout.compute(frame, rows, cols);
+    }
+
+    // Lay the frame out on a blank screen, then write only what differs.
+    target.assign(static_cast<size_t>(rows) * cols, kBlankCell);
+    for (int y = 0; y < frame.get_height(); ++y) {
+        int screen_y = layout.origin_y + y;
+        if (screen_y >= rows) {
+            break;
+        }
+        Cell* out = target.data() + static_cast<size_t>(screen_y) * cols;
+        const Cell* cells = frame.row(y);
+        int line_x = layout.line_x[y];
+        int count = std::min(layout.line_widths[y], cols - line_x);
+        if (count > 0) {
+            std::copy(cells, cells + count, out + line_x);
+        }
+        blank_split_wide_glyphs(out, cols);
+    }
+    for (int y = 0; y < rows; ++y) {
+        const Cell* row = target.data() + static_cast<size_t>(y) * cols;
+        for (int x = 0; x < cols; ++x) {
+            put_cell(y, x, row[x]);
+        }
+    }
+}
+
+void AnsiRenderer::draw_changes(const Frame& frame, std::span<const CellUpdate> changes) {
+    if (!layout.matches(frame)) {
+        draw_frame(frame);
+        return;
+    }
+    StageTimer timer(Stage::draw);
+    for (const auto& change : changes) {
+        int y = layout.origin_y + change.y;
+        int x = layout.line_x[change.y] + change.x;
+        if (y >= rows || x >= cols) {
+            continue;
+        }
+        // A wide glyph cut off by the right edge cannot be shown.
+        bool clipped = change.cell.width == 2 && x + 1 >= cols;
+        put_cell(y, x, clipped ? kBlankCell : change.cell);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_ANSI_RENDERER_H
+#define FRAME_ANSI_RENDERER_H
+
+#include "cell.h"
+#include "renderer.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+// Encodes frames as ANSI escape sequences into an in-memory buffer, for writing
+// to files or streams. It keeps a model of everything it has encoded so far,
+// so only cells that differ from what is already on screen are written.
+class AnsiRenderer : public Renderer {
+public:
+    // The screen starts at the given size and grows whenever a frame would not
+    // fit; growing clears it and redraws the frame at its new position.
+    AnsiRenderer(int rows, int cols);
+
+    // Fixes the screen at the given size, for a terminal whose size is known:
+    // from then on frames that do not fit are clipped instead of growing the
+    // screen. The model is reset to a blank screen, so clear the screen next.
+    void resize(int new_rows, int new_cols);
+
+    void clear_screen() override;
+    void draw_frame(const Frame& frame) override;
+    void draw_changes(const Frame& frame, std::span<const CellUpdate> changes) override;
+
+    // There is no keyboard: waiting for quit returns immediately and quit is never requested.
+    void wait_for_quit() override {}
+    bool wait_for_quit_until(std::chrono::steady_clock::time_point deadline) override {
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+
+    // Appends the sequences that hand the terminal back, such as showing the cursor again.
+    void finish();
+
+    // The bytes encoded since the last call to clear_output().
+    const std::string& get_output() const { return output; }
+    void clear_output() { output.clear(); }
+
+    int get_rows() const { return rows; }
+    int get_cols() const { return cols; }
+
+private:
+    // Writes one cell if it differs from the screen model.
+    void put_cell(int y, int x, const Cell& cell);
+
+    // Switches the terminal to the cell's colors and style with one SGR
+    // sequence, unless they are already current.
+    void set_attributes(const Cell& cell);
+
+    // Puts the terminal back to its default colors and style.
+    void reset_attributes();
+
+    // Moves the cursor, unless it is already there, with the shortest sequence
+    // that gets it there: rewriting known cells, a relative move, or a jump.
+    void move_to(int y, int x);
+
+    int rows;
+    int cols;
+    bool fixed_size = false;
+    std::vector<Cell> screen; // What the output so far leaves on screen
+    std::vector<Cell> target; // Scratch: the screen a full draw should produce
+    FrameLayout layout;
+    int cursor_y = -1; // Unknown until the first move
+    int cursor_x = -1;
+    Cell pen = kBlankCell;   // The colors and style the terminal currently draws with
+    bool pen_known = false;  // Unknown until the first SGR sequence
+    std::string glyph_buffer;
+    std::string output;
+};
+
+#endif //FRAME_ANSI_RENDERER_H
@@ -0,0 +1,276 @@
+#include "baked.h"
+#include "animator.h"
+#include "config.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>    // For open
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
+#include <unistd.h>   // For close
+
+namespace {
+
+// Records start on 8-byte boundaries so the cell arrays inside are aligned.
+size_t align8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+void write_padding(std::ofstream& out, size_t written) {
+    static const char zeros[8] = {};
+    out.write(zeros, align8(written) - written);
+}
+
+template <typename T>
+void write_raw(std::ofstream& out, const T* values, size_t count) {
+    out.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+}
+
+constexpr const char* kCorruptMessage = "Baked animation is truncated or corrupt.";
+
+// Replaces a baked grapheme handle with the one its cluster has in this process.
+void remap_glyph(Cell& cell, const std::vector<char32_t>& handles) {
+    if (cell.glyph < kGraphemeHandleBase) {
+        return;
+    }
+    size_t index = cell.glyph - kGraphemeHandleBase;
+    if (index >= handles.size()) {
+        throw std::runtime_error(kCorruptMessage);
+    }
+    cell.glyph = handles[index];
+}
+
+} // namespace
+
+void bake_animation(const Animator& animator, const Config& config, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open bake output file: " + path);
+    }
+
+    Config pass_config = config;
+    pass_config.loop = false;
+    pass_config.pipeline_depth = 0;
+    Sequencer sequencer(animator, pass_config);
+
+    // The header is rewritten at the end, once the counts are known.
+    baked::FileHeader header = {};
+    std::memcpy(header.magic, baked::kMagic, sizeof(header.magic));
+    header.version = baked::kVersion;
+    header.cell_size = sizeof(Cell);
+    write_raw(out, &header, 1);
+
+    Tick tick;
+    std::vector<std::int32_t> line_widths;
+    size_t offset = sizeof(header);
+    while (sequencer.next(tick)) {
+        const Frame& frame = *tick.frame;
+        baked::TickHeader record = {};
+        record.hold_ms = static_cast<std::uint32_t>(tick.hold.count());
+        if (tick.full) {
+            record.kind = baked::kFullTick;
+            record.width = frame.get_width();
+            record.height = frame.get_height();
+            write_raw(out, &record, 1);
+
+            line_widths.resize(frame.get_height());
+            for (int y = 0; y < frame.get_height(); ++y) {
+                line_widths[y] = frame.get_line_width(y);
+            }
+            size_t cell_count = static_cast<size_t>(frame.get_width()) * frame.get_height();
+            write_raw(out, line_widths.data(), line_widths.size());
+            write_padding(out, sizeof(std::int32_t) * line_widths.size());
+            if (cell_count > 0) {
+                write_raw(out, frame.row(0), cell_count);
+            }
+            write_padding(out, sizeof(Cell) * cell_count);
+            offset += sizeof(record) + align8(sizeof(std::int32_t) * line_widths.size()) + align8(sizeof(Cell) * cell_count);
+
+            header.max_width = std::max<std::uint32_t>(header.max_width, frame.get_width());
+            header.max_height = std::max<std::uint32_t>(header.max_height, frame.get_height());
+        } else {
+            record.kind = baked::kDeltaTick;
+            record.width = static_cast<std::uint32_t>(tick.changes.size());
+            write_raw(out, &record, 1);
+            write_raw(out, tick.changes.data(), tick.changes.size());
+            write_padding(out, sizeof(CellUpdate) * tick.changes.size());
+            offset += sizeof(record) + align8(sizeof(CellUpdate) * tick.changes.size());
+        }
+        ++header.tick_count;
+    }
+
+    // Grapheme clusters go last, since the table is only complete once every
+    // frame has been generated: a length-prefixed string each.
+    std::vector<std::string> graphemes = grapheme_table_snapshot();
+    header.grapheme_count = static_cast<std::uint32_t>(graphemes.size());
+    header.grapheme_offset = offset;
+    for (const auto& cluster : graphemes) {
+        std::uint32_t length = static_cast<std::uint32_t>(cluster.size());
+        write_raw(out, &length, 1);
+        out.write(cluster.data(), cluster.size());
+    }
+
+    out.seekp(0);
+    write_raw(out, &header, 1);
+    if (!out.good()) {
+        throw std::runtime_error("Failed to write bake output file: " + path);
+    }
+}
+
+BakedPlayer::BakedPlayer(const std::string& path, const Config& config)
+    : loop(config.loop), loop_pause_ms(static_cast<std::uint32_t>(config.loop_pause_ms)) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open baked animation: " + path);
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(baked::FileHeader))) {
+        close(fd);
+        throw std::runtime_error("Not a baked animation: " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map baked animation: " + path);
+    }
+    data = static_cast<const unsigned char*>(mapping);
+    header = reinterpret_cast<const baked::FileHeader*>(data);
+
+    if (std::memcmp(header->magic, baked::kMagic, sizeof(header->magic)) != 0 ||
+        header->version != baked::kVersion || header->cell_size != sizeof(Cell) ||
+        header->tick_count == 0) {
+        munmap(mapping, size);
+        throw std::runtime_error("Not a compatible baked animation: " + path);
+    }
+    auto corrupt = [&] {
+        munmap(mapping, size);
+        return std::runtime_error("Baked animation is truncated or corrupt: " + path);
+    };
+    if (header->grapheme_offset < sizeof(baked::FileHeader) || header->grapheme_offset > size ||
+        header->max_width > INT_MAX || header->max_height > INT_MAX) {
+        throw corrupt();
+    }
+
+    // Re-intern the grapheme clusters. When nothing else was interned first
+    // they come back exactly as they were baked; otherwise (text layers, or
+    // other baked layers) cells are translated as they are read.
+    std::vector<char32_t> handles;
+    bool same_handles = true;
+    size_t offset = header->grapheme_offset;
+    for (std::uint32_t i = 0; i < header->grapheme_count; ++i) {
+        std::uint32_t length;
+        if (size - offset < sizeof(length)) {
+            throw corrupt();
+        }
+        std::memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        if (size - offset < length) {
+            throw corrupt();
+        }
+        char32_t handle = intern_grapheme(std::string_view(reinterpret_cast<const char*>(data + offset), length));
+        offset += length;
+        handles.push_back(handle);
+        same_handles = same_handles && handle == kGraphemeHandleBase + i;
+    }
+    if (!same_handles) {
+        grapheme_handles = std::move(handles);
+    }
+    first_tick = sizeof(baked::FileHeader);
+    cursor = first_tick;
+}
+
+BakedPlayer::~BakedPlayer() {
+    munmap(const_cast<unsigned char*>(data), size);
+}
+
+bool BakedPlayer::next(Tick& tick) {
+    if (ticks_played == header->tick_count) {
+        if (!loop) {
+            return false;
+        }
+        ticks_played = 0;
+        cursor = first_tick;
+    }
+
+    // Everything read below is checked against the end of the tick records
+    // first, dividing rather than multiplying so huge sizes cannot overflow.
+    size_t end = header->grapheme_offset;
+    if (end - cursor < sizeof(baked::TickHeader)) {
+        throw std::runtime_error(kCorruptMessage);
+    }
+    const auto* record = reinterpret_cast<const baked::TickHeader*>(data + cursor);
+    cursor += sizeof(baked::TickHeader);
+    size_t available = end - cursor;
+
+    if (record->kind == baked::kFullTick) {
+        size_t width = record->width;
+        size_t height = record->height;
+        if (width > header->max_width || height > header->max_height ||
+            height > available / sizeof(std::int32_t) ||
+            (height > 0 && width > available / sizeof(Cell) / height)) {
+            throw std::runtime_error(kCorruptMessage);
+        }
+        size_t payload = align8(sizeof(std::int32_t) * height) + align8(sizeof(Cell) * width * height);
+        if (payload > available) {
+            throw std::runtime_error(kCorruptMessage);
+        }
+        const auto* line_widths = reinterpret_cast<const std::int32_t*>(data + cursor);
+        for (size_t y = 0; y < height; ++y) {
+            if (line_widths[y] < 0 || static_cast<size_t>(line_widths[y]) > width) {
+                throw std::runtime_error(kCorruptMessage);
+            }
+        }
+        cursor += align8(sizeof(std::int32_t) * height);
+        const auto* cells = reinterpret_cast<const Cell*>(data + cursor);
+        cursor += align8(sizeof(Cell) * width * height);
+        shown.assign(static_cast<int>(width), static_cast<int>(height), cells, line_widths);
+        if (!grapheme_handles.empty()) {
+            for (int y = 0; y < shown.get_height(); ++y) {
+                Cell* row = shown.row(y);
+                for (int x = 0; x < shown.get_width(); ++x) {
+                    remap_glyph(row[x], grapheme_handles);
+                }
+            }
+        }
+        tick.full = true;
+        tick.changes = {};
+    } else if (record->kind == baked::kDeltaTick) {
+        // A delta can only land inside the frame it changes; before the first
+        // full tick that frame is empty.
+        if (record->width > available / sizeof(CellUpdate) ||
+            align8(sizeof(CellUpdate) * record->width) > available) {
+            throw std::runtime_error(kCorruptMessage);
+        }
+        const auto* updates = reinterpret_cast<const CellUpdate*>(data + cursor);
+        cursor += align8(sizeof(CellUpdate) * record->width);
+        tick.changes = std::span<const CellUpdate>(updates, record->width);
+        for (const auto& update : tick.changes) {
+            if (update.y < 0 || update.y >= shown.get_height() || update.x < 0 || update.x >= shown.get_width()) {
+                throw std::runtime_error(kCorruptMessage);
+            }
+        }
+        if (!grapheme_handles.empty()) {
+            remapped.assign(tick.changes.begin(), tick.changes.end());
+            for (auto& update : remapped) {
+                remap_glyph(update.cell, grapheme_handles);
+            }
+            tick.changes = remapped;
+        }
+        shown.apply(tick.changes);
+        tick.full = false;
+    } else {
+        throw std::runtime_error(kCorruptMessage);
+    }
+    tick.frame = &shown;
+    tick.hold = std::chrono::milliseconds(record->hold_ms);
+
+    // The last tick of a pass carries the pause before looping.
+    if (++ticks_played == header->tick_count && loop) {
+        tick.hold = std::chrono::milliseconds(loop_pause_ms);
+    }
+    return true;
+}
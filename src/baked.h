@@ -0,0 +1,94 @@
+#ifndef FRAME_BAKED_H
+#define FRAME_BAKED_H
+
+#include "frame.h"
+#include "sequencer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class Animator;
+struct Config;
+
+// On-disk layout of a baked animation. The file is a cache of one pass through
+// the sequence: every tick, already decoded and interpolated, in playback order.
+// Integers and cells are stored in native layout so playback can read them
+// straight out of a memory mapping; a file is not portable between architectures.
+namespace baked {
+
+constexpr char kMagic[8] = {'F', 'R', 'A', 'M', 'E', 'B', 'K', '1'};
+constexpr std::uint32_t kVersion = 2; // 2: cells grew colors and style
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t tick_count;
+    std::uint32_t max_width;   // Largest frame, so players can size their screen up front
+    std::uint32_t max_height;
+    std::uint32_t cell_size;      // sizeof(Cell) when baked, as a layout check
+    std::uint32_t grapheme_count; // Multi-codepoint clusters, stored after the last tick
+    std::uint64_t grapheme_offset;
+};
+
+static_assert(sizeof(FileHeader) % 8 == 0, "tick records must start 8-byte aligned");
+static_assert(std::is_trivially_copyable_v<Cell> && std::is_trivially_copyable_v<CellUpdate>,
+              "cells are written and mapped as raw bytes");
+
+enum TickKind : std::uint32_t {
+    kFullTick = 0,  // Followed by int32 line widths[height], then Cell[width * height]
+    kDeltaTick = 1, // Followed by CellUpdate[count]
+};
+
+struct TickHeader {
+    std::uint32_t kind;
+    std::uint32_t hold_ms;
+    std::uint32_t width;  // Full ticks: frame width. Delta ticks: number of updates.
+    std::uint32_t height; // Full ticks only
+};
+
+static_assert(sizeof(TickHeader) % 8 == 0, "tick payloads must start 8-byte aligned");
+
+} // namespace baked
+
+// Seed used for baking when none is given, so baking the same frames twice
+// gives the same file.
+constexpr std::uint64_t kDefaultBakeSeed = 1;
+
+// Plays the sequence once (ignoring `loop`) and writes every tick to `path`.
+// Throws std::runtime_error if the file cannot be written.
+void bake_animation(const Animator& animator, const Config& config, const std::string& path);
+
+// Plays a baked animation from a read-only memory mapping: no text parsing and
+// no frame generation. Delta ticks are handed to the renderer straight from the mapping.
+class BakedPlayer : public TickSource {
+public:
+    // Throws std::runtime_error if the file is missing or not a baked animation.
+    BakedPlayer(const std::string& path, const Config& config);
+    ~BakedPlayer() override;
+
+    BakedPlayer(const BakedPlayer&) = delete;
+    BakedPlayer& operator=(const BakedPlayer&) = delete;
+
+    bool next(Tick& tick) override;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    const baked::FileHeader* header = nullptr;
+    size_t first_tick = 0; // Offset of the first tick record
+    size_t cursor = 0;
+    std::uint32_t ticks_played = 0;
+    bool loop;
+    std::uint32_t loop_pause_ms;
+    Frame shown;
+
+    // The handle each of the file's grapheme clusters got in this process, by
+    // its index in the file. Empty when they got the handles they were baked
+    // with, which is the case unless other frames interned clusters first.
+    std::vector<char32_t> grapheme_handles;
+    std::vector<CellUpdate> remapped; // A delta tick's updates with translated handles
+};
+
+#endif //FRAME_BAKED_H
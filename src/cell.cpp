@@ -0,0 +1,371 @@
+#include "cell.h"
+#include <algorithm>
+#include <cwchar> // For wcwidth
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+constexpr char32_t kZeroWidthJoiner = 0x200D;
+constexpr unsigned char kEscape = 0x1B;
+
+// Process-wide table of multi-codepoint grapheme clusters (e.g. a letter plus
+// combining accents, or ZWJ emoji sequences). A deque keeps the stored strings
+// at stable addresses as the table grows.
+struct GraphemeTable {
+    std::mutex mutex;
+    std::deque<std::string> clusters;
+    std::unordered_map<std::string_view, char32_t> handles;
+};
+
+GraphemeTable& grapheme_table() {
+    static GraphemeTable table;
+    return table;
+}
+
+// Decodes one codepoint starting at `p`. Returns the number of bytes consumed,
+// or 0 if the sequence is invalid or truncated.
+int decode_codepoint(const unsigned char* p, const unsigned char* limit, char32_t& cp) {
+    unsigned char lead = p[0];
+    int len;
+    if (lead < 0x80) {
+        cp = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        cp = lead & 0x1F;
+        len = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        cp = lead & 0x0F;
+        len = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        cp = lead & 0x07;
+        len = 4;
+    } else {
+        return 0;
+    }
+    if (limit - p < len) {
+        return 0;
+    }
+    for (int i = 1; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    // Reject overlong encodings, surrogates and values past U+10FFFF.
+    static constexpr char32_t kMinForLength[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (cp < kMinForLength[len] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return 0;
+    }
+    return len;
+}
+
+void append_codepoint_utf8(char32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Checks whether every byte is printable 7-bit ASCII (0x20..0x7E). Written as
+// a branch-free reduction so the compiler turns it into SIMD compares.
+bool is_printable_ascii(std::string_view text) {
+    unsigned char outside = 0;
+    for (unsigned char c : text) {
+        outside |= static_cast<unsigned char>(static_cast<unsigned char>(c - 0x20) >= 0x5F);
+    }
+    return outside == 0;
+}
+
+// An entry of the xterm 256-color palette as RGB: the 16 system colors, then
+// a 6x6x6 color cube, then a ramp of grays.
+std::uint32_t palette_color(int index) {
+    static constexpr std::uint32_t kSystemColors[16] = {
+        0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd, 0xe5e5e5,
+        0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff, 0x00ffff, 0xffffff,
+    };
+    if (index < 16) {
+        return kSystemColors[index];
+    }
+    if (index < 232) {
+        index -= 16;
+        auto level = [](int step) { return static_cast<std::uint32_t>(step == 0 ? 0 : 55 + 40 * step); };
+        return (level(index / 36) << 16) | (level(index / 6 % 6) << 8) | level(index % 6);
+    }
+    auto gray = static_cast<std::uint32_t>(8 + 10 * (index - 232));
+    return (gray << 16) | (gray << 8) | gray;
+}
+
+// Applies the parameters of one SGR escape (the text between ESC [ and m) to the pen.
+void apply_sgr(std::string_view text, CellPen& pen) {
+    constexpr int kMaxParams = 32;
+    int params[kMaxParams];
+    int count = 0;
+    int value = 0;
+    for (char c : text) {
+        if (c >= '0' && c <= '9') {
+            value = std::min(value * 10 + (c - '0'), 0xFFFF);
+        } else if (count < kMaxParams - 1) { // ';', or ':' between sub-parameters
+            params[count++] = value;
+            value = 0;
+        }
+    }
+    params[count++] = value; // An empty list means 0, a reset
+
+    // 38 and 48 pick a color from the palette (;5;n) or as RGB (;2;r;g;b).
+    auto extended_color = [&](int& i, std::uint32_t& color) {
+        if (i + 2 < count && params[i + 1] == 5) {
+            color = palette_color(params[i + 2] & 0xFF);
+            i += 2;
+        } else if (i + 4 < count && params[i + 1] == 2) {
+            color = static_cast<std::uint32_t>(std::min(params[i + 2], 255) << 16 |
+                                               std::min(params[i + 3], 255) << 8 | std::min(params[i + 4], 255));
+            i += 4;
+        }
+    };
+
+    for (int i = 0; i < count; ++i) {
+        int code = params[i];
+        switch (code) {
+            case 0: pen = CellPen(); break;
+            case 1: pen.style |= kStyleBold; break;
+            case 2: pen.style |= kStyleDim; break;
+            case 3: pen.style |= kStyleItalic; break;
+            case 4: case 21: pen.style |= kStyleUnderline; break;
+            case 5: case 6: pen.style |= kStyleBlink; break;
+            case 7: pen.style |= kStyleReverse; break;
+            case 9: pen.style |= kStyleStrike; break;
+            case 22: pen.style &= static_cast<std::uint8_t>(~(kStyleBold | kStyleDim)); break;
+            case 23: pen.style &= static_cast<std::uint8_t>(~kStyleItalic); break;
+            case 24: pen.style &= static_cast<std::uint8_t>(~kStyleUnderline); break;
+            case 25: pen.style &= static_cast<std::uint8_t>(~kStyleBlink); break;
+            case 27: pen.style &= static_cast<std::uint8_t>(~kStyleReverse); break;
+            case 29: pen.style &= static_cast<std::uint8_t>(~kStyleStrike); break;
+            case 38: extended_color(i, pen.fg); break;
+            case 39: pen.fg = kDefaultColor; break;
+            case 48: extended_color(i, pen.bg); break;
+            case 49: pen.bg = kDefaultColor; break;
+            default:
+                if (code >= 30 && code <= 37) {
+                    pen.fg = palette_color(code - 30);
+                } else if (code >= 40 && code <= 47) {
+                    pen.bg = palette_color(code - 40);
+                } else if (code >= 90 && code <= 97) {
+                    pen.fg = palette_color(code - 90 + 8);
+                } else if (code >= 100 && code <= 107) {
+                    pen.bg = palette_color(code - 100 + 8);
+                }
+                break; // Anything else has no cell attribute to set.
+        }
+    }
+}
+
+// Skips the escape sequence starting at `p` (which points at ESC) and returns
+// where the text resumes. SGR sequences are applied to `pen`; cursor movement
+// and every other sequence mean nothing in a frame file and are dropped.
+const unsigned char* skip_escape(const unsigned char* p, const unsigned char* limit, CellPen& pen) {
+    ++p;
+    if (p == limit) {
+        return p;
+    }
+    if (*p == '[') {
+        // CSI: parameter bytes, intermediate bytes, then one final byte.
+        const unsigned char* params = ++p;
+        while (p < limit && *p >= 0x30 && *p <= 0x3F) {
+            ++p;
+        }
+        const unsigned char* params_end = p;
+        while (p < limit && *p >= 0x20 && *p <= 0x2F) {
+            ++p;
+        }
+        if (p == limit) {
+            return p;
+        }
+        bool private_params = params_end > params && *params >= 0x3C; // <, =, > or ?
+        if (*p == 'm' && params_end == p && !private_params) {
+            apply_sgr(std::string_view(reinterpret_cast<const char*>(params), params_end - params), pen);
+        }
+        return p + 1;
+    }
+    if (*p == ']') {
+        // OSC, such as a window title: runs to BEL or ESC backslash.
+        for (++p; p < limit; ++p) {
+            if (*p == 0x07) {
+                return p + 1;
+            }
+            if (*p == kEscape && p + 1 < limit && p[1] == '\\') {
+                return p + 2;
+            }
+        }
+        return p;
+    }
+    // Any other escape: intermediate bytes (as in ESC ( B), then one final byte.
+    while (p < limit && *p >= 0x20 && *p <= 0x2F) {
+        ++p;
+    }
+    return p < limit ? p + 1 : p;
+}
+
+} // namespace
+
+char32_t intern_grapheme(std::string_view utf8) {
+    GraphemeTable& table = grapheme_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto it = table.handles.find(utf8);
+    if (it != table.handles.end()) {
+        return it->second;
+    }
+    const std::string& stored = table.clusters.emplace_back(utf8);
+    char32_t handle = kGraphemeHandleBase + static_cast<char32_t>(table.clusters.size() - 1);
+    table.handles.emplace(stored, handle);
+    return handle;
+}
+
+std::vector<std::string> grapheme_table_snapshot() {
+    GraphemeTable& table = grapheme_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    return std::vector<std::string>(table.clusters.begin(), table.clusters.end());
+}
+
+void blank_split_wide_glyphs(Cell* cells, int count) {
+    for (int x = 0; x < count; ++x) {
+        bool orphaned_right = cells[x].width == 0 && (x == 0 || cells[x - 1].width != 2);
+        bool orphaned_left = cells[x].width == 2 && (x + 1 >= count || cells[x + 1].width != 0);
+        if (orphaned_right || orphaned_left) {
+            cells[x] = kBlankCell;
+        }
+    }
+}
+
+void append_glyph_utf8(char32_t glyph, std::string& out) {
+    if (glyph < kGraphemeHandleBase) {
+        append_codepoint_utf8(glyph, out);
+        return;
+    }
+    GraphemeTable& table = grapheme_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    std::size_t index = glyph - kGraphemeHandleBase;
+    if (index < table.clusters.size()) {
+        out += table.clusters[index];
+    }
+}
+
+int decode_utf8_line(std::string_view line, std::vector<Cell>& out) {
+    CellPen pen;
+    return decode_utf8_line(line, out, pen);
+}
+
+int decode_utf8_line(std::string_view line, std::vector<Cell>& out, CellPen& pen) {
+    // Every cell starts from the pen's colors and style.
+    Cell styled = kBlankCell;
+    styled.style = pen.style;
+    styled.fg = pen.fg;
+    styled.bg = pen.bg;
+
+    // Fast path: most art is plain ASCII, where every byte is one column.
+    if (is_printable_ascii(line)) {
+        size_t first = out.size();
+        out.resize(first + line.size());
+        Cell* cells = out.data() + first;
+        for (size_t i = 0; i < line.size(); ++i) {
+            styled.glyph = static_cast<unsigned char>(line[i]);
+            cells[i] = styled;
+        }
+        return static_cast<int>(line.size());
+    }
+
+    const auto* p = reinterpret_cast<const unsigned char*>(line.data());
+    const auto* const limit = p + line.size();
+
+    int line_width = 0;
+    // The cell holding the cluster currently being built, and where its bytes start.
+    std::size_t cluster_cell = out.size();
+    const unsigned char* cluster_begin = nullptr;
+    const unsigned char* cluster_end = nullptr;
+    int cluster_codepoints = 0;
+    bool join_next = false;
+
+    auto finish_cluster = [&]() {
+        if (cluster_codepoints > 1) {
+            out[cluster_cell].glyph = intern_grapheme(std::string_view(
+                reinterpret_cast<const char*>(cluster_begin), cluster_end - cluster_begin));
+        }
+        cluster_codepoints = 0;
+    };
+
+    while (p < limit) {
+        char32_t cp;
+        int len = decode_codepoint(p, limit, cp);
+        if (len == 0) { // Invalid byte, skip it to avoid an infinite loop.
+            ++p;
+            continue;
+        }
+        const unsigned char* next = p + len;
+
+        if (cp == kEscape) {
+            // Escapes take no columns; colors change for the cells after them.
+            p = skip_escape(p, limit, pen);
+            styled.style = pen.style;
+            styled.fg = pen.fg;
+            styled.bg = pen.bg;
+            continue;
+        }
+
+        int cp_width = wcwidth(static_cast<wchar_t>(cp));
+        if (cp < 0x20 || cp == 0x7F) {
+            // Control characters (tabs, stray carriage returns) have no cell.
+            p = next;
+            continue;
+        }
+        if (cp_width < 0) {
+            // Printable but unknown to the current locale; assume a single column.
+            cp_width = 1;
+        }
+
+        if (cluster_codepoints > 0 && (cp_width == 0 || join_next)) {
+            // Combining marks, variation selectors and joined codepoints extend
+            // the previous cluster instead of taking a column of their own.
+            cluster_end = next;
+            ++cluster_codepoints;
+            join_next = (cp == kZeroWidthJoiner);
+            p = next;
+            continue;
+        }
+        if (cp_width == 0) { // Nothing to attach to at the start of a line.
+            p = next;
+            continue;
+        }
+
+        finish_cluster();
+        cluster_cell = out.size();
+        cluster_begin = p;
+        cluster_end = next;
+        cluster_codepoints = 1;
+        join_next = false;
+
+        int w = cp_width > 2 ? 2 : cp_width;
+        styled.glyph = cp;
+        styled.width = static_cast<std::uint8_t>(w);
+        out.push_back(styled);
+        if (w == 2) {
+            out.push_back({U' ', 0});
+        }
+        line_width += w;
+        p = next;
+    }
+    finish_cluster();
+
+    return line_width;
+}
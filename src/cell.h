@@ -0,0 +1,101 @@
+#ifndef FRAME_CELL_H
+#define FRAME_CELL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Glyph values at or above this are handles into the grapheme table rather
+// than plain Unicode codepoints (which never exceed U+10FFFF).
+constexpr char32_t kGraphemeHandleBase = 0x110000;
+
+// Cell colors are 24-bit RGB, 0xRRGGBB. This value, outside that range,
+// stands for the terminal's own default color.
+constexpr std::uint32_t kDefaultColor = 0x01000000;
+
+// Style bits of Cell::style, as set by SGR escapes.
+constexpr std::uint8_t kStyleBold = 1 << 0;
+constexpr std::uint8_t kStyleDim = 1 << 1;
+constexpr std::uint8_t kStyleItalic = 1 << 2;
+constexpr std::uint8_t kStyleUnderline = 1 << 3;
+constexpr std::uint8_t kStyleBlink = 1 << 4;
+constexpr std::uint8_t kStyleReverse = 1 << 5;
+constexpr std::uint8_t kStyleStrike = 1 << 6;
+
+// One terminal column of a frame: a fixed 128-bit record with the glyph and
+// its attributes, so colors cost nothing to carry through interpolation and
+// drawing. The right half of a wide glyph has no attributes of its own.
+struct Cell {
+    // A Unicode codepoint, or a grapheme handle for clusters of more than one codepoint.
+    char32_t glyph = U' ';
+    // Display width: 1 or 2 for a glyph, 0 for the right half of a wide glyph.
+    std::uint8_t width = 1;
+    // kStyle* bits.
+    std::uint8_t style = 0;
+    // Unused; kept zero so cells compare and serialize byte for byte.
+    std::uint8_t reserved[2] = {};
+    std::uint32_t fg = kDefaultColor;
+    std::uint32_t bg = kDefaultColor;
+
+    bool operator==(const Cell& other) const = default;
+
+    // True if both cells are drawn with the same colors and style.
+    bool has_same_attributes(const Cell& other) const {
+        return style == other.style && fg == other.fg && bg == other.bg;
+    }
+};
+
+// The cell used for padding and for columns past the end of a line.
+constexpr Cell kBlankCell = {U' ', 1};
+
+// The colors and style that SGR escapes have selected so far while decoding.
+// Carried from one line to the next, as a terminal would.
+struct CellPen {
+    std::uint32_t fg = kDefaultColor;
+    std::uint32_t bg = kDefaultColor;
+    std::uint8_t style = 0;
+};
+
+// Decodes a line of UTF-8 text into cells, one per display column, and appends
+// them to `out`. SGR escapes (ESC [ ... m) update `pen`, which colors the cells
+// that follow; other escape sequences, invalid bytes and control characters are
+// skipped. Returns the display width of the line.
+int decode_utf8_line(std::string_view line, std::vector<Cell>& out, CellPen& pen);
+
+// The same, for a line decoded on its own with the default colors.
+int decode_utf8_line(std::string_view line, std::vector<Cell>& out);
+
+// Mixes two colors, `weight` out of 256 of the way from `from` to `to`. The
+// terminal's default color cannot be mixed, so it switches over halfway.
+inline std::uint32_t blend_color(std::uint32_t from, std::uint32_t to, std::uint32_t weight) {
+    if (from == to) {
+        return from;
+    }
+    if (from == kDefaultColor || to == kDefaultColor) {
+        return weight < 128 ? from : to;
+    }
+    std::uint32_t blended = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        std::uint32_t a = (from >> shift) & 0xFF;
+        std::uint32_t b = (to >> shift) & 0xFF;
+        blended |= ((a * (256 - weight) + b * weight) >> 8) << shift;
+    }
+    return blended;
+}
+
+// Replaces with blanks any wide glyph in a run of cells whose two halves are
+// no longer side by side, as happens when rows are cut or overlaid.
+void blank_split_wide_glyphs(Cell* cells, int count);
+
+// Appends the UTF-8 encoding of a glyph (codepoint or grapheme handle) to `out`.
+void append_glyph_utf8(char32_t glyph, std::string& out);
+
+// Returns the handle for a multi-codepoint grapheme cluster, interning it on first use.
+// The table is shared by all frames and is safe to use from several threads.
+char32_t intern_grapheme(std::string_view utf8);
+
+// Returns a copy of every interned cluster, in handle order.
+std::vector<std::string> grapheme_table_snapshot();
+
+#endif //FRAME_CELL_H
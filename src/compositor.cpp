@@ -0,0 +1,175 @@
+#include "compositor.h"
+#include "baked.h"
+#include "config.h"
+#include "frame_store.h"
+#include "random.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+Compositor::Compositor(const Config& config) {
+    if (config.layers.empty()) {
+        throw std::runtime_error("Compositor requires at least one layer.");
+    }
+    if (config.layers.size() >= kNoLayer) {
+        throw std::runtime_error("Too many layers.");
+    }
+
+    for (size_t i = 0; i < config.layers.size(); ++i) {
+        const LayerConfig& layer_config = config.layers[i];
+        Config layer_settings = layer_config.config;
+        // Layers sharing a seed would otherwise dissolve in lockstep.
+        if (layer_settings.seed) {
+            layer_settings.seed = derive_key(*layer_settings.seed, i);
+        }
+
+        Layer& layer = layers.emplace_back();
+        if (!layer_settings.baked_path.empty()) {
+            layer.source = std::make_unique<BakedPlayer>(layer_settings.baked_path, layer_settings);
+        } else {
+            layer.animator = std::make_unique<Animator>(layer_settings);
+            if (layer_settings.precompute) {
+                layer.source = std::make_unique<StoredPlayer>(store_animation(*layer.animator, layer_settings), layer_settings);
+            } else {
+                layer.source = make_tick_source(*layer.animator, layer_settings);
+            }
+        }
+        int rate = std::max(layer_settings.frame_rate, 1);
+        layer.x = std::max(layer_config.x, 0);
+        layer.y = std::max(layer_config.y, 0);
+        layer.period = std::chrono::nanoseconds(1'000'000'000) / rate;
+        tick_rate = std::max(tick_rate, rate);
+    }
+    tick_period = std::chrono::nanoseconds(1'000'000'000) / tick_rate;
+}
+
+bool Compositor::next(Tick& tick) {
+    if (started) {
+        clock += tick_period;
+    }
+    changes.clear();
+
+    // Advance every layer whose next frame is due. A layer that has finished
+    // keeps showing its last frame.
+    bool needs_rebuild = !started;
+    bool any_playing = false;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        Layer& layer = layers[i];
+        if (layer.finished) {
+            continue;
+        }
+        any_playing = true;
+        if (layer.due > clock) {
+            continue;
+        }
+        Tick layer_tick;
+        if (!layer.source->next(layer_tick)) {
+            layer.finished = true;
+            continue;
+        }
+        layer.frame = layer_tick.frame;
+        layer.due += layer.period + layer_tick.hold;
+        if (layer_tick.full) {
+            needs_rebuild = true;
+        } else if (!needs_rebuild) {
+            // Once a rebuild is due it picks up this layer's frame as a whole.
+            apply_changes(i, layer_tick.changes);
+        }
+    }
+    if (!any_playing) {
+        return false;
+    }
+
+    tick.full = needs_rebuild && rebuild();
+    tick.frame = &composite;
+    tick.changes = changes;
+    tick.hold = std::chrono::milliseconds(0);
+    started = true;
+    return true;
+}
+
+bool Compositor::rebuild() {
+    // The composite grows to hold every layer at its position, and never shrinks
+    // so that layers do not jump around on screen.
+    int width = composite.get_width();
+    int height = composite.get_height();
+    for (const Layer& layer : layers) {
+        if (layer.frame != nullptr) {
+            width = std::max(width, layer.x + layer.frame->get_width());
+            height = std::max(height, layer.y + layer.frame->get_height());
+        }
+    }
+    bool resized = width != composite.get_width() || height != composite.get_height();
+
+    if (scratch.get_width() != width || scratch.get_height() != height) {
+        scratch = Frame(width, height);
+    } else {
+        std::fill(scratch.row(0), scratch.row(0) + static_cast<size_t>(width) * height, kBlankCell);
+    }
+    scratch_owner.assign(static_cast<size_t>(width) * height, kNoLayer);
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const Layer& layer = layers[i];
+        if (layer.frame == nullptr) {
+            continue;
+        }
+        const Frame& frame = *layer.frame;
+        for (int y = 0; y < frame.get_height(); ++y) {
+            int composite_y = layer.y + y;
+            int composite_x = layer.x + frame.get_line_offset(y);
+            const Cell* cells = frame.row(y);
+            Cell* out = scratch.row(composite_y) + composite_x;
+            std::uint8_t* owned = scratch_owner.data() + static_cast<size_t>(composite_y) * width + composite_x;
+            std::copy(cells, cells + frame.get_line_width(y), out);
+            std::fill(owned, owned + frame.get_line_width(y), static_cast<std::uint8_t>(i));
+        }
+    }
+
+    // The composite is placed as one block, so every line spans its full width.
+    for (int y = 0; y < height; ++y) {
+        blank_split_wide_glyphs(scratch.row(y), width);
+        scratch.set_line_width(y, width);
+    }
+
+    bool full = resized || !started;
+    if (!full) {
+        for (int y = 0; y < height; ++y) {
+            const Cell* before = composite.row(y);
+            const Cell* after = scratch.row(y);
+            for (int x = 0; x < width; ++x) {
+                if (!(before[x] == after[x])) {
+                    changes.push_back({y, x, after[x]});
+                }
+            }
+        }
+    }
+    std::swap(composite, scratch);
+    std::swap(owner, scratch_owner);
+    return full;
+}
+
+void Compositor::apply_changes(size_t index, std::span<const CellUpdate> layer_changes) {
+    const Layer& layer = layers[index];
+    int width = composite.get_width();
+    int height = composite.get_height();
+    for (const auto& change : layer_changes) {
+        int y = layer.y + change.y;
+        int x = layer.x + layer.frame->get_line_offset(change.y) + change.x;
+        if (y >= height || x >= width) {
+            continue;
+        }
+        size_t at = static_cast<size_t>(y) * width + x;
+        if (owner[at] != index) {
+            continue; // Covered by a layer above
+        }
+        // Half of a wide glyph whose other half is covered cannot be shown.
+        Cell cell = change.cell;
+        bool split = (cell.width == 2 && (x + 1 >= width || owner[at + 1] != index)) ||
+                     (cell.width == 0 && (x == 0 || owner[at - 1] != index));
+        if (split) {
+            cell = kBlankCell;
+        }
+        composite.at(y, x) = cell;
+        changes.push_back({y, x, cell});
+    }
+}
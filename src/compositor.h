@@ -0,0 +1,64 @@
+#ifndef FRAME_COMPOSITOR_H
+#define FRAME_COMPOSITOR_H
+
+#include "animator.h"
+#include "frame.h"
+#include "sequencer.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct Config;
+
+// Plays several independent animations (the `[[layers]]` of frame.toml) as one.
+// Each layer keeps its own frames, rate, pauses and effect, and is placed at its
+// own position; later layers are drawn over earlier ones, and columns past the
+// end of a layer's lines are transparent. Every tick composites the layers into
+// one frame, so the terminal is rendered once per tick however many layers
+// there are.
+class Compositor : public TickSource {
+public:
+    // Loads every layer. Throws std::runtime_error if a layer cannot be played.
+    explicit Compositor(const Config& config);
+
+    bool next(Tick& tick) override;
+
+    // Ticks per second needed to show every layer at its own rate: that of the fastest layer.
+    int get_tick_rate() const { return tick_rate; }
+
+private:
+    struct Layer {
+        std::unique_ptr<Animator> animator; // Unset when playing a baked file
+        std::unique_ptr<TickSource> source;
+        int x = 0;
+        int y = 0;
+        std::chrono::nanoseconds period{0};
+        std::chrono::nanoseconds due{0}; // When the layer's next frame is due, on the compositor's clock
+        const Frame* frame = nullptr;    // The layer's current frame
+        bool finished = false;
+    };
+
+    static constexpr std::uint8_t kNoLayer = 0xFF;
+
+    // Composites every layer's current frame from scratch and reports the cells
+    // that differ from what was shown. Returns true if the whole frame must be redrawn.
+    bool rebuild();
+
+    // Writes one layer's changed cells into the composite where that layer is on top.
+    void apply_changes(size_t index, std::span<const CellUpdate> layer_changes);
+
+    std::vector<Layer> layers;
+    int tick_rate = 1;
+    std::chrono::nanoseconds tick_period{0};
+    std::chrono::nanoseconds clock{0};
+    bool started = false;
+
+    Frame composite;
+    Frame scratch;                   // Rebuilt composite, swapped in after diffing
+    std::vector<std::uint8_t> owner; // Topmost layer at each composite cell, or kNoLayer
+    std::vector<std::uint8_t> scratch_owner;
+    std::vector<CellUpdate> changes;
+};
+
+#endif //FRAME_COMPOSITOR_H
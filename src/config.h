@@ -1,6 +1,8 @@
 #ifndef FRAME_CONFIG_H
 #define FRAME_CONFIG_H
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -8,6 +10,8 @@
 #include "cxxopts.hpp"
 #include "toml.hpp"
 
+struct LayerConfig;
+
 struct Config {
     std::string mode;
     std::vector<std::string> frame_paths;
@@ -16,9 +20,39 @@ struct Config {
     int pause_ms = 0;
     int loop_pause_ms = 0;
     bool loop = false;
+    std::string dissolve = "random";
+    std::string transition = "dissolve";          // Effect for every segment without its own
+    std::vector<std::string> segment_transitions; // Effect for each segment in turn (F1->F2, F2->F3, ...)
+    int stream_window = 0;      // Frames to keep loaded ahead of the playhead; 0 loads everything up front
+    int stream_memory_mb = 64;  // Cap on frames prefetched by the streaming loader
+    int keyframe_interval = 0;  // Keep frames as keyframes every N frames plus deltas; 0 keeps them whole
+    bool precompute = false;    // Generate one pass up front and play it back from a frame store
+    bool memoize = false;       // Keep each generated segment and replay it on later loops
+    int threads = 0;            // Worker threads for loading and generation; 0 uses every core
+    std::optional<std::uint64_t> seed; // Fixed seed for reproducible dissolves
+    int pipeline_depth = 0; // Frames generated ahead on a worker thread; 0 generates inline
+    std::string baked_path;  // Play this baked animation instead of the frame files
+    std::string output_path; // Where `frame bake` writes its file
+    std::string late_policy = "catchup"; // What to do when playback falls behind (catchup, skip, reset)
+    bool watch = false; // Reload edited frame files and config while playing
+    std::string renderer = "notcurses"; // Terminal backend: notcurses, or ansi for raw escape sequences
+    bool show_stats = false; // Report timing and per-stage latency when playback ends
+    std::string stats_path;  // Write the report there as JSON instead of printing it
+    int bench_passes = 0; // Passes of the headless benchmark to run instead of playing (0: play)
+    std::string export_path;   // Non-empty writes the animation to this file instead of playing it
+    std::string export_format; // asciicast or ansi; empty picks by the export file's extension
+    std::vector<LayerConfig> layers; // Independent animations played together; see Compositor
     std::string config_file = "frame.toml";
 };
 
+// One `[[layers]]` entry: an animation with its own settings, placed with its
+// top-left corner `x` columns and `y` rows into the composited frame.
+struct LayerConfig {
+    Config config;
+    int x = 0;
+    int y = 0;
+};
+
 inline Config parse_config(int argc, char** argv) {
     Config config;
     // The default path is relative to the build directory, so we go up one level.
@@ -35,11 +69,37 @@ inline Config parse_config(int argc, char** argv) {
         ("l,loop", "Loop animation", cxxopts::value<bool>())
         ("p,pause", "Pause between interpolations in ms", cxxopts::value<int>())
         ("loop-pause", "Pause between loops in ms", cxxopts::value<int>())
+        ("d,dissolve", "Dissolve style (random, stable)", cxxopts::value<std::string>())
+        ("t,transition", "Transition effect (dissolve, wipe_h, wipe_v, slide, morph)", cxxopts::value<std::string>())
+        ("stream", "Stream frames from disk, keeping N frames loaded ahead", cxxopts::value<int>())
+        ("stream-memory", "Memory cap in MiB for streamed frames", cxxopts::value<int>())
+        ("keyframes", "Store frames as a keyframe every N frames plus cell deltas", cxxopts::value<int>())
+        ("precompute", "Generate the whole animation up front and replay it", cxxopts::value<bool>())
+        ("memoize", "Keep each segment once generated and replay it on later loops", cxxopts::value<bool>())
+        ("j,threads", "Worker threads for loading and generating frames (0 = one per core)", cxxopts::value<int>())
+        ("seed", "Seed for the dissolve, for reproducible output", cxxopts::value<std::uint64_t>())
+        ("pipeline", "Generate up to N frames ahead on a worker thread", cxxopts::value<int>())
+        ("o,output", "Output file for 'frame bake'", cxxopts::value<std::string>())
+        ("play", "Play a baked animation file", cxxopts::value<std::string>())
+        ("w,watch", "Reload frame files and the config file when they are edited", cxxopts::value<bool>())
+        ("renderer", "Terminal backend (notcurses, ansi)", cxxopts::value<std::string>())
+        ("late", "When playback falls behind: catchup, skip or reset", cxxopts::value<std::string>())
+        ("stats", "Report per-stage latency when playback ends; with =FILE, write it as JSON", cxxopts::value<std::string>()->implicit_value(""))
+        ("export", "Write the animation to FILE instead of playing it", cxxopts::value<std::string>())
+        ("export-format", "Export file format (asciicast, ansi); default from the file extension", cxxopts::value<std::string>())
+        ("bench", "Benchmark the animation headlessly for N passes, no terminal needed", cxxopts::value<int>()->implicit_value("1"))
         ("c,config", "Path to config file", cxxopts::value<std::string>(config_path_from_cli))
         ("h,help", "Print usage");
     
     options.parse_positional({"frames"});
 
+    // `frame bake ...` is a subcommand: drop the word and parse the rest as usual.
+    bool bake_command = argc > 1 && std::string(argv[1]) == "bake";
+    if (bake_command) {
+        --argc;
+        ++argv;
+    }
+
     auto result = options.parse(argc, argv);
 
     if (result.count("help")) {
@@ -65,6 +125,66 @@ inline Config parse_config(int argc, char** argv) {
         config.pause_ms = tbl["pause_ms"].value_or(0);
         config.loop_pause_ms = tbl["loop_pause_ms"].value_or(0);
         config.loop = tbl["loop"].value_or(false);
+        config.dissolve = tbl["dissolve"].value_or("random");
+        config.transition = tbl["transition"].value_or("dissolve");
+        if (auto transitions = tbl["transitions"].as_array()) {
+            for (auto&& el : *transitions) {
+                config.segment_transitions.push_back(el.value_or("dissolve"));
+            }
+        }
+        config.pipeline_depth = tbl["pipeline_depth"].value_or(0);
+        config.threads = tbl["threads"].value_or(0);
+        if (auto seed = tbl["seed"].value<int64_t>()) {
+            config.seed = static_cast<std::uint64_t>(*seed);
+        }
+        config.stream_window = tbl["stream_window"].value_or(0);
+        config.stream_memory_mb = tbl["stream_memory_mb"].value_or(64);
+        config.keyframe_interval = tbl["keyframe_interval"].value_or(0);
+        config.precompute = tbl["precompute"].value_or(false);
+        config.memoize = tbl["memoize"].value_or(false);
+        config.baked_path = tbl["baked"].value_or("");
+        config.late_policy = tbl["late_policy"].value_or("catchup");
+        config.watch = tbl["watch"].value_or(false);
+        config.renderer = tbl["renderer"].value_or("notcurses");
+
+        // Each layer starts from the settings above and overrides what it lists.
+        if (auto layers = tbl["layers"].as_array()) {
+            for (auto&& node : *layers) {
+                auto* layer_tbl = node.as_table();
+                if (layer_tbl == nullptr) {
+                    continue;
+                }
+                LayerConfig layer;
+                layer.config = config;
+                Config& lc = layer.config;
+                lc.layers.clear();
+                if (auto frames = (*layer_tbl)["frames"].as_array()) {
+                    lc.frame_paths.clear();
+                    for (auto&& el : *frames) {
+                        lc.frame_paths.push_back(el.value_or(""));
+                    }
+                }
+                lc.steps = (*layer_tbl)["steps"].value_or(lc.steps);
+                lc.frame_rate = (*layer_tbl)["rate"].value_or(lc.frame_rate);
+                lc.pause_ms = (*layer_tbl)["pause_ms"].value_or(lc.pause_ms);
+                lc.loop_pause_ms = (*layer_tbl)["loop_pause_ms"].value_or(lc.loop_pause_ms);
+                lc.loop = (*layer_tbl)["loop"].value_or(lc.loop);
+                lc.dissolve = (*layer_tbl)["dissolve"].value_or(lc.dissolve);
+                lc.transition = (*layer_tbl)["transition"].value_or(lc.transition);
+                if (auto transitions = (*layer_tbl)["transitions"].as_array()) {
+                    lc.segment_transitions.clear();
+                    for (auto&& el : *transitions) {
+                        lc.segment_transitions.push_back(el.value_or("dissolve"));
+                    }
+                }
+                lc.precompute = (*layer_tbl)["precompute"].value_or(lc.precompute);
+                lc.memoize = (*layer_tbl)["memoize"].value_or(lc.memoize);
+                lc.baked_path = (*layer_tbl)["baked"].value_or(lc.baked_path);
+                layer.x = (*layer_tbl)["x"].value_or(0);
+                layer.y = (*layer_tbl)["y"].value_or(0);
+                config.layers.push_back(std::move(layer));
+            }
+        }
 
     } catch (const toml::parse_error& err) {
         // Don't fail if the config file doesn't exist, just use defaults.
@@ -83,6 +203,53 @@ inline Config parse_config(int argc, char** argv) {
     if (result.count("pause")) config.pause_ms = result["pause"].as<int>();
     if (result.count("loop-pause")) config.loop_pause_ms = result["loop-pause"].as<int>();
     if (result.count("loop")) config.loop = result["loop"].as<bool>();
+    if (result.count("dissolve")) config.dissolve = result["dissolve"].as<std::string>();
+    if (result.count("transition")) {
+        // An effect given on the command line applies to every segment.
+        config.transition = result["transition"].as<std::string>();
+        config.segment_transitions.clear();
+    }
+    if (result.count("stream")) config.stream_window = result["stream"].as<int>();
+    if (result.count("stream-memory")) config.stream_memory_mb = result["stream-memory"].as<int>();
+    if (result.count("keyframes")) config.keyframe_interval = result["keyframes"].as<int>();
+    if (result.count("precompute")) config.precompute = result["precompute"].as<bool>();
+    if (result.count("memoize")) config.memoize = result["memoize"].as<bool>();
+    if (result.count("threads")) config.threads = result["threads"].as<int>();
+    if (result.count("seed")) config.seed = result["seed"].as<std::uint64_t>();
+    if (result.count("pipeline")) config.pipeline_depth = result["pipeline"].as<int>();
+    if (result.count("output")) config.output_path = result["output"].as<std::string>();
+    if (result.count("play")) config.baked_path = result["play"].as<std::string>();
+    if (result.count("watch")) config.watch = result["watch"].as<bool>();
+    if (result.count("renderer")) config.renderer = result["renderer"].as<std::string>();
+    if (result.count("late")) config.late_policy = result["late"].as<std::string>();
+    if (result.count("stats")) {
+        config.show_stats = true;
+        config.stats_path = result["stats"].as<std::string>();
+    }
+    if (bake_command) config.mode = "bake";
+    if (result.count("export")) config.export_path = result["export"].as<std::string>();
+    if (result.count("export-format")) config.export_format = result["export-format"].as<std::string>();
+    if (result.count("bench")) {
+        config.bench_passes = result["bench"].as<int>();
+        // Zero would otherwise fall through to playing in the terminal.
+        if (config.bench_passes < 1) {
+            std::cerr << "Error: --bench needs at least 1 pass." << std::endl;
+            exit(1);
+        }
+    }
+
+    // Process-wide settings are shared by every layer, wherever they were given.
+    for (auto& layer : config.layers) {
+        layer.config.threads = config.threads;
+        layer.config.seed = config.seed;
+        layer.config.pipeline_depth = config.pipeline_depth;
+        layer.config.stream_window = config.stream_window;
+        layer.config.stream_memory_mb = config.stream_memory_mb;
+        layer.config.keyframe_interval = config.keyframe_interval;
+        // Per-layer settings given on the command line still apply to every layer.
+        if (result.count("precompute")) layer.config.precompute = config.precompute;
+        if (result.count("memoize")) layer.config.memoize = config.memoize;
+    }
 
     return config;
 }
@@ -0,0 +1,131 @@
+#include "dissolve_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAME_X86_KERNELS 1
+#endif
+
+static_assert(sizeof(Cell) == 16, "the vector kernels blend cells as 128-bit lanes");
+
+namespace {
+
+void dissolve_row_scalar(const Cell* start, const Cell* end, Cell* out, int count,
+                         std::uint32_t row_seed, std::uint32_t threshold) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = (dissolve_hash(row_seed + static_cast<std::uint32_t>(i)) < threshold) ? end[i] : start[i];
+    }
+}
+
+#ifdef FRAME_X86_KERNELS
+
+// SSE2 has no 32-bit low multiply, so build it from two 32x32->64 multiplies.
+inline __m128i mullo_epi32_sse2(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+__attribute__((target("sse2")))
+void dissolve_row_sse2(const Cell* start, const Cell* end, Cell* out, int count,
+                       std::uint32_t row_seed, std::uint32_t threshold) {
+    const __m128i k1 = _mm_set1_epi32(0x7feb352d);
+    const __m128i k2 = _mm_set1_epi32(static_cast<int>(0x846ca68bU));
+    // Unsigned compare via signed compare on sign-flipped values.
+    const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000U));
+    const __m128i limit = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(threshold)), flip);
+    __m128i counter = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(row_seed)), _mm_setr_epi32(0, 1, 2, 3));
+    const __m128i four = _mm_set1_epi32(4);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i h = counter;
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+        h = mullo_epi32_sse2(h, k1);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+        h = mullo_epi32_sse2(h, k2);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+        counter = _mm_add_epi32(counter, four);
+
+        // One 32-bit mask per cell, broadcast to cover each 128-bit cell.
+        __m128i take_end = _mm_cmplt_epi32(_mm_xor_si128(h, flip), limit);
+        __m128i masks[4] = {
+            _mm_shuffle_epi32(take_end, _MM_SHUFFLE(0, 0, 0, 0)),
+            _mm_shuffle_epi32(take_end, _MM_SHUFFLE(1, 1, 1, 1)),
+            _mm_shuffle_epi32(take_end, _MM_SHUFFLE(2, 2, 2, 2)),
+            _mm_shuffle_epi32(take_end, _MM_SHUFFLE(3, 3, 3, 3)),
+        };
+
+        const auto* s = reinterpret_cast<const __m128i*>(start + i);
+        const auto* e = reinterpret_cast<const __m128i*>(end + i);
+        auto* o = reinterpret_cast<__m128i*>(out + i);
+        for (int j = 0; j < 4; ++j) {
+            __m128i sj = _mm_loadu_si128(s + j);
+            __m128i ej = _mm_loadu_si128(e + j);
+            _mm_storeu_si128(o + j, _mm_or_si128(_mm_and_si128(masks[j], ej), _mm_andnot_si128(masks[j], sj)));
+        }
+    }
+    dissolve_row_scalar(start + i, end + i, out + i, count - i, row_seed + static_cast<std::uint32_t>(i), threshold);
+}
+
+__attribute__((target("avx2")))
+void dissolve_row_avx2(const Cell* start, const Cell* end, Cell* out, int count,
+                       std::uint32_t row_seed, std::uint32_t threshold) {
+    const __m256i k1 = _mm256_set1_epi32(0x7feb352d);
+    const __m256i k2 = _mm256_set1_epi32(static_cast<int>(0x846ca68bU));
+    const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+    const __m256i limit = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(threshold)), flip);
+    __m256i counter = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(row_seed)),
+                                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i eight = _mm256_set1_epi32(8);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i h = counter;
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, k1);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+        h = _mm256_mullo_epi32(h, k2);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        counter = _mm256_add_epi32(counter, eight);
+
+        // take_end = h < threshold (unsigned); each 256-bit store holds two
+        // cells, so each half of its mask is one cell's lane broadcast.
+        __m256i take_end = _mm256_cmpgt_epi32(limit, _mm256_xor_si256(h, flip));
+
+        const auto* s = reinterpret_cast<const __m256i*>(start + i);
+        const auto* e = reinterpret_cast<const __m256i*>(end + i);
+        auto* o = reinterpret_cast<__m256i*>(out + i);
+        for (int j = 0; j < 4; ++j) {
+            __m256i lanes = _mm256_setr_epi32(2 * j, 2 * j, 2 * j, 2 * j, 2 * j + 1, 2 * j + 1, 2 * j + 1, 2 * j + 1);
+            __m256i mask = _mm256_permutevar8x32_epi32(take_end, lanes);
+            _mm256_storeu_si256(o + j, _mm256_blendv_epi8(_mm256_loadu_si256(s + j), _mm256_loadu_si256(e + j), mask));
+        }
+    }
+    dissolve_row_sse2(start + i, end + i, out + i, count - i, row_seed + static_cast<std::uint32_t>(i), threshold);
+}
+
+#endif // FRAME_X86_KERNELS
+
+using DissolveRowFn = void (*)(const Cell*, const Cell*, Cell*, int, std::uint32_t, std::uint32_t);
+
+DissolveRowFn select_dissolve_row() {
+#ifdef FRAME_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return dissolve_row_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return dissolve_row_sse2;
+    }
+#endif
+    return dissolve_row_scalar;
+}
+
+} // namespace
+
+void dissolve_row(const Cell* start, const Cell* end, Cell* out, int count,
+                  std::uint32_t row_seed, std::uint32_t threshold) {
+    static const DissolveRowFn kernel = select_dissolve_row();
+    kernel(start, end, out, count, row_seed, threshold);
+}
@@ -0,0 +1,29 @@
+#ifndef FRAME_DISSOLVE_KERNEL_H
+#define FRAME_DISSOLVE_KERNEL_H
+
+#include "cell.h"
+#include <cstdint>
+
+// Counter-based hash used as the dissolve's random source: column i of a row
+// draws dissolve_hash(row_seed + i). Every kernel below uses the same function,
+// so the SIMD and scalar paths produce identical frames.
+inline std::uint32_t dissolve_hash(std::uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// Random dissolve over a run of single-width cells: out[i] = end[i] where the
+// column's random draw is below `threshold` (progress scaled to 2^32), and
+// start[i] otherwise. Rows containing wide glyphs must use the general path,
+// which keeps both halves of a wide glyph together.
+//
+// Dispatches at runtime to the widest vector unit available (AVX2 or SSE2 on
+// x86) and falls back to a scalar loop elsewhere.
+void dissolve_row(const Cell* start, const Cell* end, Cell* out, int count,
+                  std::uint32_t row_seed, std::uint32_t threshold);
+
+#endif //FRAME_DISSOLVE_KERNEL_H
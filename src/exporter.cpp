@@ -0,0 +1,178 @@
+#include "exporter.h"
+#include "ansi_renderer.h"
+#include "sequencer.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// Output is gathered in memory and written in batches of about this size.
+constexpr size_t kBatchBytes = 1 << 20;
+
+// A file written in large batches.
+class BatchedFile {
+public:
+    explicit BatchedFile(const std::string& path) : path(path), out(path, std::ios::binary | std::ios::trunc) {
+        if (!out.is_open()) {
+            throw std::runtime_error("Could not open export output file: " + path);
+        }
+        batch.reserve(kBatchBytes);
+    }
+
+    std::string& buffer() { return batch; }
+
+    void maybe_flush() {
+        if (batch.size() >= kBatchBytes) {
+            flush();
+        }
+    }
+
+    void flush() {
+        out.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        batch.clear();
+    }
+
+    // Flushes, then overwrites the start of the file with `header`, which must
+    // be exactly as long as the placeholder written there first.
+    void finish(std::string_view header) {
+        flush();
+        out.seekp(0);
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+        out.flush();
+        if (!out.good()) {
+            throw std::runtime_error("Failed to write export output file: " + path);
+        }
+    }
+
+private:
+    std::string path;
+    std::ofstream out;
+    std::string batch;
+};
+
+// Appends `bytes` as the body of a JSON string.
+void append_json_escaped(std::string& out, std::string_view bytes) {
+    static const char kHex[] = "0123456789abcdef";
+    for (char c : bytes) {
+        auto byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (byte < 0x20) {
+            out += "\\u00";
+            out += kHex[byte >> 4];
+            out += kHex[byte & 0xF];
+        } else {
+            out += c; // UTF-8 passes through unchanged
+        }
+    }
+}
+
+void append_seconds(std::string& out, double seconds) {
+    char text[32];
+    int length = std::snprintf(text, sizeof(text), "%.6f", seconds);
+    out.append(text, static_cast<size_t>(length));
+}
+
+// The screen size is only known once every frame has been drawn, so headers
+// are written with fixed-width numbers and rewritten at the end.
+std::string asciicast_header(int cols, int rows) {
+    char text[96];
+    int length = std::snprintf(text, sizeof(text), "{\"version\": 2, \"width\": %6d, \"height\": %6d}\n", cols, rows);
+    return std::string(text, static_cast<size_t>(length));
+}
+
+std::string typescript_header(int cols, int rows) {
+    char text[96];
+    int length = std::snprintf(text, sizeof(text), "Script started by frame export [COLUMNS=\"%6d\" LINES=\"%6d\"]\n", cols, rows);
+    return std::string(text, static_cast<size_t>(length));
+}
+
+} // namespace
+
+ExportFormat parse_export_format(const std::string& name, const std::string& path) {
+    if (name == "asciicast") {
+        return ExportFormat::asciicast;
+    }
+    if (name == "ansi") {
+        return ExportFormat::ansi;
+    }
+    if (name.empty()) {
+        bool cast = path.size() >= 5 && path.compare(path.size() - 5, 5, ".cast") == 0;
+        return cast ? ExportFormat::asciicast : ExportFormat::ansi;
+    }
+    throw std::runtime_error("Unknown export format '" + name + "'");
+}
+
+ExportSummary export_animation(TickSource& source, int frame_rate, ExportFormat format, const std::string& path) {
+    BatchedFile file(path);
+    std::unique_ptr<BatchedFile> timing;
+    if (format == ExportFormat::asciicast) {
+        file.buffer() += asciicast_header(0, 0);
+    } else {
+        file.buffer() += typescript_header(0, 0);
+        timing = std::make_unique<BatchedFile>(path + ".timing");
+    }
+
+    auto period = std::chrono::nanoseconds(1'000'000'000) / (frame_rate > 0 ? frame_rate : 1);
+    std::chrono::nanoseconds now{0};   // When the current frame is shown
+    std::chrono::nanoseconds last{0};  // When the previous chunk was shown
+
+    ExportSummary summary;
+    auto write_chunk = [&](const std::string& bytes) {
+        if (bytes.empty()) {
+            return;
+        }
+        std::string& out = file.buffer();
+        if (format == ExportFormat::asciicast) {
+            out += '[';
+            append_seconds(out, std::chrono::duration<double>(now).count());
+            out += ", \"o\", \"";
+            append_json_escaped(out, bytes);
+            out += "\"]\n";
+        } else {
+            out += bytes;
+            std::string& times = timing->buffer();
+            append_seconds(times, std::chrono::duration<double>(now - last).count());
+            times += ' ';
+            times += std::to_string(bytes.size());
+            times += '\n';
+            timing->maybe_flush();
+        }
+        file.maybe_flush();
+        summary.bytes += bytes.size();
+        last = now;
+    };
+
+    AnsiRenderer renderer(0, 0);
+    renderer.clear_screen();
+    Tick tick;
+    while (source.next(tick)) {
+        if (tick.full) {
+            renderer.draw_frame(*tick.frame);
+        } else {
+            renderer.draw_changes(*tick.frame, tick.changes);
+        }
+        write_chunk(renderer.get_output());
+        renderer.clear_output();
+        ++summary.frames;
+        now += period + std::chrono::duration_cast<std::chrono::nanoseconds>(tick.hold);
+    }
+    renderer.finish();
+    write_chunk(renderer.get_output());
+
+    summary.rows = renderer.get_rows();
+    summary.cols = renderer.get_cols();
+    summary.duration = std::chrono::duration<double>(last).count();
+    if (format == ExportFormat::asciicast) {
+        file.finish(asciicast_header(summary.cols, summary.rows));
+    } else {
+        file.finish(typescript_header(summary.cols, summary.rows));
+        timing->flush();
+        timing->finish("");
+    }
+    return summary;
+}
@@ -0,0 +1,34 @@
+#ifndef FRAME_EXPORTER_H
+#define FRAME_EXPORTER_H
+
+#include <cstdint>
+#include <string>
+
+class TickSource;
+
+// File formats for `--export`.
+enum class ExportFormat {
+    asciicast, // asciicast v2: a JSON header line, then one [time, "o", data] event per frame
+    ansi,      // Raw ANSI in a `script` typescript, with scriptreplay timing in <file>.timing
+};
+
+// Parses "asciicast" or "ansi". An empty name picks asciicast for paths ending
+// in ".cast" and ansi otherwise. Throws std::runtime_error for other names.
+ExportFormat parse_export_format(const std::string& name, const std::string& path);
+
+struct ExportSummary {
+    std::uint64_t frames = 0;
+    std::uint64_t bytes = 0; // Terminal output, not counting the container format
+    double duration = 0.0;   // Seconds of animation
+    int rows = 0;
+    int cols = 0;
+};
+
+// Plays `source` to its end as fast as it can be generated and writes the
+// terminal output to `path`, timestamped as if shown at `frame_rate`. Only the
+// cells that change from one frame to the next are encoded. Output is gathered
+// into large batches before it is written. Throws std::runtime_error if the
+// file cannot be written.
+ExportSummary export_animation(TickSource& source, int frame_rate, ExportFormat format, const std::string& path);
+
+#endif //FRAME_EXPORTER_H
@@ -0,0 +1,80 @@
+#include "file_watcher.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/inotify.h> // For inotify_init1, inotify_add_watch
+#include <unistd.h>      // For read, close
+
+namespace {
+
+std::string directory_of(const std::string& path) {
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    return directory.empty() ? "." : directory;
+}
+
+std::string key_for(const std::string& directory, const std::string& name) {
+    return directory + "/" + name;
+}
+
+} // namespace
+
+FileWatcher::FileWatcher(const std::vector<std::string>& paths) {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Could not start watching files (inotify unavailable).");
+    }
+
+    std::map<std::string, int> watch_for_directory;
+    for (const auto& path : paths) {
+        std::string directory = directory_of(path);
+        if (watch_for_directory.find(directory) == watch_for_directory.end()) {
+            // A file is complete once it is closed after writing, or renamed into place.
+            int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0) {
+                continue; // Missing directory: nothing there can change.
+            }
+            watch_for_directory[directory] = wd;
+            directories[wd] = directory;
+        }
+        std::string name = std::filesystem::path(path).filename().string();
+        auto& entries = watched[key_for(directory, name)];
+        if (std::find(entries.begin(), entries.end(), path) == entries.end()) {
+            entries.push_back(path);
+        }
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break; // EAGAIN: nothing more queued.
+        }
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            auto directory = directories.find(event->wd);
+            if (event->len == 0 || directory == directories.end()) {
+                continue;
+            }
+            auto entry = watched.find(key_for(directory->second, event->name));
+            if (entry == watched.end()) {
+                continue;
+            }
+            for (const auto& path : entry->second) {
+                if (std::find(changed.begin(), changed.end(), path) == changed.end()) {
+                    changed.push_back(path);
+                }
+            }
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,30 @@
+#ifndef FRAME_FILE_WATCHER_H
+#define FRAME_FILE_WATCHER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports edits to a set of files through inotify. The directories holding the
+// files are watched rather than the files themselves, so editors that save by
+// writing a new file and renaming it over the old one are seen too.
+class FileWatcher {
+public:
+    // Throws std::runtime_error if inotify is unavailable.
+    explicit FileWatcher(const std::vector<std::string>& paths);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Returns the watched paths, as given to the constructor, that were written
+    // or replaced since the last call, each once. Never blocks.
+    std::vector<std::string> poll();
+
+private:
+    int fd = -1;
+    std::map<int, std::string> directories;                   // Watch descriptor -> directory
+    std::map<std::string, std::vector<std::string>> watched; // Directory/name -> paths as given
+};
+
+#endif //FRAME_FILE_WATCHER_H
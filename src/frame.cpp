@@ -1,8 +1,13 @@
 #include "frame.h"
-#include <fstream>
+#include "random.h"
+#include "stage_stats.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
-#include <notcurses/notcurses.h>
-#include <utility>
+#include <string_view>
+#include <fcntl.h>    // For open
+#include <sys/stat.h> // For fstat
+#include <unistd.h>   // For read, close
 
 Frame::Frame() : width(0), height(0) {}
 
@@ -12,52 +17,115 @@ Frame::Frame(const std::string& path) : width(0), height(0) {
     }
 }
 
-Frame::Frame(std::vector<std::string> new_pixels) : pixels(std::move(new_pixels)) {
-    height = pixels.size();
-    width = 0;
-    if (height > 0) {
-        for (const auto& line : pixels) {
-            int valid_bytes = 0;
-            int valid_width = 0;
-            int line_width = ncstrwidth(line.c_str(), &valid_bytes, &valid_width);
-            if (line_width < 0) {
-                line_width = valid_width;
-            }
-            if (line_width > width) {
-                width = line_width;
-            }
-        }
-    }
+Frame::Frame(const std::vector<std::string>& lines) : width(0), height(0) {
+    assign_lines(std::vector<std::string_view>(lines.begin(), lines.end()));
 }
 
+Frame::Frame(int width, int height)
+    : cells(static_cast<size_t>(width) * height, kBlankCell),
+      line_widths(height, 0),
+      line_offsets(height, width / 2),
+      width(width),
+      height(height) {}
+
 bool Frame::load_from_file(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
+    StageTimer timer(Stage::load);
+
+    // Read the whole file with a single read into one buffer, then split it
+    // into lines in place.
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
         return false;
     }
-
-    pixels.clear();
-    std::string line;
-    width = 0;
-    while (std::getline(file, line)) {
-        pixels.push_back(line);
-        int valid_bytes = 0;
-        int valid_width = 0;
-        int line_width = ncstrwidth(line.c_str(), &valid_bytes, &valid_width);
-        if (line_width < 0) {
-            line_width = valid_width;
-        }
-        if (line_width > width) {
-            width = line_width;
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    std::string contents(static_cast<size_t>(st.st_size), '\0');
+    size_t filled = 0;
+    while (filled < contents.size()) {
+        ssize_t n = read(fd, contents.data() + filled, contents.size() - filled);
+        if (n <= 0) {
+            break;
         }
+        filled += static_cast<size_t>(n);
     }
+    close(fd);
+    contents.resize(filled);
 
-    height = pixels.size();
+    std::vector<std::string_view> lines;
+    std::string_view rest = contents;
+    while (!rest.empty()) {
+        size_t newline = rest.find('\n');
+        if (newline == std::string_view::npos) {
+            lines.push_back(rest);
+            break;
+        }
+        lines.push_back(rest.substr(0, newline));
+        rest.remove_prefix(newline + 1);
+    }
 
-    file.close();
+    assign_lines(lines);
     return true;
 }
 
+void Frame::assign_lines(const std::vector<std::string_view>& lines) {
+    // Decode every line into one scratch buffer first, since the grid width is
+    // only known once the widest line has been measured. A line never decodes
+    // to more cells than it has bytes, so one reservation covers them all.
+    size_t total_bytes = 0;
+    for (const auto& text : lines) {
+        total_bytes += text.size();
+    }
+    std::vector<Cell> decoded;
+    decoded.reserve(total_bytes);
+    std::vector<size_t> line_starts;
+    line_starts.reserve(lines.size() + 1);
+    line_widths.clear();
+    line_widths.reserve(lines.size());
+    width = 0;
+    CellPen pen; // Colors set on one line carry on to the next
+    for (const auto& text : lines) {
+        line_starts.push_back(decoded.size());
+        int line_width = decode_utf8_line(text, decoded, pen);
+        line_widths.push_back(line_width);
+        width = std::max(width, line_width);
+    }
+    line_starts.push_back(decoded.size());
+    height = static_cast<int>(lines.size());
+    wide_glyphs = std::any_of(decoded.begin(), decoded.end(), [](const Cell& cell) { return cell.width != 1; });
+    update_line_offsets();
+
+    // When every line is as wide as the frame, the decoded cells already are
+    // the grid. Multi-byte text reserved more than it used, so that is trimmed.
+    if (decoded.size() == static_cast<size_t>(width) * height) {
+        cells = std::move(decoded);
+        cells.shrink_to_fit();
+        return;
+    }
+    cells.assign(static_cast<size_t>(width) * height, kBlankCell);
+    for (int y = 0; y < height; ++y) {
+        std::copy(decoded.begin() + line_starts[y], decoded.begin() + line_starts[y + 1], row(y));
+    }
+}
+
+void Frame::assign(int new_width, int new_height, const Cell* new_cells, const std::int32_t* new_line_widths) {
+    width = new_width;
+    height = new_height;
+    cells.assign(new_cells, new_cells + static_cast<size_t>(width) * height);
+    line_widths.assign(new_line_widths, new_line_widths + height);
+    wide_glyphs = std::any_of(cells.begin(), cells.end(), [](const Cell& cell) { return cell.width != 1; });
+    update_line_offsets();
+}
+
+void Frame::update_line_offsets() {
+    line_offsets.resize(height);
+    for (int y = 0; y < height; ++y) {
+        line_offsets[y] = (width - line_widths[y]) / 2;
+    }
+}
+
 int Frame::get_width() const {
     return width;
 }
@@ -66,6 +134,52 @@ int Frame::get_height() const {
     return height;
 }
 
-const std::vector<std::string>& Frame::get_pixels() const {
-    return pixels;
-}
\ No newline at end of file
+size_t Frame::get_memory_usage() const {
+    return cells.capacity() * sizeof(Cell) + (line_widths.capacity() + line_offsets.capacity()) * sizeof(int);
+}
+
+std::uint64_t Frame::get_content_hash() const {
+    std::uint64_t hash = mix64((static_cast<std::uint64_t>(width) << 32) | static_cast<std::uint32_t>(height));
+    for (int line_width : line_widths) {
+        hash = mix64(hash ^ static_cast<std::uint32_t>(line_width));
+    }
+    for (const Cell& cell : cells) {
+        std::uint64_t bits[2];
+        static_assert(sizeof(bits) == sizeof(Cell));
+        std::memcpy(bits, &cell, sizeof(bits));
+        hash = mix64(hash ^ bits[0] ^ mix64(bits[1]));
+    }
+    return hash;
+}
+
+bool Frame::has_same_content(const Frame& other) const {
+    return width == other.width && height == other.height && line_widths == other.line_widths &&
+           std::equal(cells.begin(), cells.end(), other.cells.begin());
+}
+
+int Frame::get_line_width(int y) const {
+    return line_widths[y];
+}
+
+void Frame::set_line_width(int y, int line_width) {
+    line_widths[y] = line_width;
+    line_offsets[y] = (width - line_width) / 2;
+}
+
+void Frame::apply(std::span<const CellUpdate> changes) {
+    for (const auto& change : changes) {
+        at(change.y, change.x) = change.cell;
+        wide_glyphs |= change.cell.width != 1;
+    }
+}
+
+std::string Frame::get_line(int y) const {
+    std::string line;
+    const Cell* cells_in_row = row(y);
+    for (int x = 0; x < line_widths[y]; ++x) {
+        if (cells_in_row[x].width > 0) {
+            append_glyph_utf8(cells_in_row[x].glyph, line);
+        }
+    }
+    return line;
+}
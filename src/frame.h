@@ -1,9 +1,20 @@
 #ifndef FRAME_FRAME_H
 #define FRAME_FRAME_H
 
+#include "cell.h"
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// A single changed cell, in frame coordinates.
+struct CellUpdate {
+    int y;
+    int x;
+    Cell cell;
+};
+
 class Frame {
 public:
     // Default constructor
@@ -12,8 +23,14 @@ public:
     // Constructor that loads a frame from a file path
     explicit Frame(const std::string& path);
 
-    // Constructor for creating a frame from raw pixel data in memory
-    explicit Frame(std::vector<std::string> new_pixels);
+    // Constructor for creating a frame from lines of UTF-8 text in memory
+    explicit Frame(const std::vector<std::string>& lines);
+
+    // Constructor for a blank frame of the given size, to be filled in cell by cell
+    Frame(int width, int height);
+
+    // Replaces the whole frame with a copy of an existing cell grid and its line widths.
+    void assign(int new_width, int new_height, const Cell* new_cells, const std::int32_t* new_line_widths);
 
     // Load a frame from a file path. Returns false if loading fails.
     bool load_from_file(const std::string& path);
@@ -21,12 +38,56 @@ public:
     // Getters
     int get_width() const;
     int get_height() const;
-    const std::vector<std::string>& get_pixels() const;
+
+    // Approximate heap memory held by the frame, in bytes.
+    size_t get_memory_usage() const;
+
+    // A hash of the frame's size, line widths and cells, so frames with the
+    // same content can be found without comparing every pair.
+    std::uint64_t get_content_hash() const;
+
+    // True if both frames have the same size, line widths and cells.
+    bool has_same_content(const Frame& other) const;
+
+    // True if any cell holds a double-width glyph. Set when the frame is loaded
+    // or assigned and when changes are applied (it stays set once a wide glyph
+    // has been applied); a frame built cell by cell reports false.
+    bool has_wide_glyphs() const { return wide_glyphs; }
+
+    // Display width of a single line. Columns past it are blank padding.
+    // Setting it also updates the line's offset.
+    int get_line_width(int y) const;
+    void set_line_width(int y, int line_width);
+
+    // Columns a line is shifted right to center it within the frame's width.
+    // Kept alongside the widths, so drawing never measures text.
+    int get_line_offset(int y) const { return line_offsets[y]; }
+
+    // Direct access to the decoded cell grid (row-major, `get_width()` cells per row).
+    const Cell* row(int y) const { return cells.data() + static_cast<size_t>(y) * width; }
+    Cell* row(int y) { return cells.data() + static_cast<size_t>(y) * width; }
+    const Cell& at(int y, int x) const { return row(y)[x]; }
+    Cell& at(int y, int x) { return row(y)[x]; }
+
+    // Writes a list of changed cells into the grid.
+    void apply(std::span<const CellUpdate> changes);
+
+    // Re-encodes a line as UTF-8 text, without its colors.
+    std::string get_line(int y) const;
 
 private:
-    std::vector<std::string> pixels;
+    // Decodes the lines once into the cell grid.
+    void assign_lines(const std::vector<std::string_view>& lines);
+
+    // Recomputes every line's offset from its width.
+    void update_line_offsets();
+
+    std::vector<Cell> cells;
+    std::vector<int> line_widths;
+    std::vector<int> line_offsets;
     int width;
     int height;
+    bool wide_glyphs = false;
 };
 
 #endif //FRAME_FRAME_H
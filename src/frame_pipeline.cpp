@@ -0,0 +1,62 @@
+#include "frame_pipeline.h"
+#include <utility>
+
+FramePipeline::FramePipeline(const Animator& animator, const Config& config, size_t depth)
+    : sequencer(animator, config), ring(depth) {
+    // Started last, once everything the worker touches has been constructed.
+    worker = std::thread(&FramePipeline::produce, this);
+}
+
+FramePipeline::~FramePipeline() {
+    ring.close();
+    worker.join();
+}
+
+void FramePipeline::produce() {
+    Tick tick;
+    while (Slot* slot = ring.acquire_write()) {
+        bool end = !sequencer.next(tick);
+        slot->end = end;
+        if (!end) {
+            // Copy the tick into the slot's own buffers, which keep their
+            // capacity from lap to lap.
+            slot->full = tick.full;
+            if (slot->full) {
+                slot->frame = *tick.frame;
+            } else {
+                slot->changes.assign(tick.changes.begin(), tick.changes.end());
+            }
+            slot->hold = tick.hold;
+        }
+        ring.commit_write();
+        if (end) {
+            break;
+        }
+    }
+}
+
+bool FramePipeline::next(Tick& tick) {
+    if (reading) {
+        ring.release_read();
+        reading = false;
+    }
+
+    Slot* slot = ring.acquire_read();
+    if (slot == nullptr || slot->end) {
+        return false;
+    }
+    reading = true;
+
+    if (slot->full) {
+        // Swap rather than copy: the old frame's buffer goes back to the worker.
+        std::swap(shown, slot->frame);
+        tick.changes = {};
+    } else {
+        shown.apply(slot->changes);
+        tick.changes = slot->changes;
+    }
+    tick.frame = &shown;
+    tick.full = slot->full;
+    tick.hold = slot->hold;
+    return true;
+}
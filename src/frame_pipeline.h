@@ -0,0 +1,43 @@
+#ifndef FRAME_FRAME_PIPELINE_H
+#define FRAME_FRAME_PIPELINE_H
+
+#include "frame.h"
+#include "sequencer.h"
+#include "spsc_ring.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+class Animator;
+struct Config;
+
+// Runs a Sequencer on a worker thread that generates upcoming frames into a
+// bounded ring, so generation overlaps with drawing and waiting on the render
+// thread. The render thread only picks up the next ready frame.
+class FramePipeline : public TickSource {
+public:
+    // `depth` is the number of frames the worker may run ahead.
+    FramePipeline(const Animator& animator, const Config& config, size_t depth);
+    ~FramePipeline() override;
+
+    bool next(Tick& tick) override;
+
+private:
+    struct Slot {
+        bool end = false;  // The sequence is over; no frame in this slot
+        bool full = false; // `frame` holds a complete frame, otherwise `changes` apply
+        Frame frame;
+        std::vector<CellUpdate> changes;
+        std::chrono::milliseconds hold{0};
+    };
+
+    void produce();
+
+    Sequencer sequencer;
+    SpscRing<Slot> ring;
+    Frame shown;          // The consumer's copy of the frame on screen
+    bool reading = false; // A slot is checked out by the consumer
+    std::thread worker;
+};
+
+#endif //FRAME_FRAME_PIPELINE_H
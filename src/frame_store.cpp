@@ -0,0 +1,196 @@
+#include "frame_store.h"
+#include "animator.h"
+#include "config.h"
+#include <algorithm>
+#include <stdexcept>
+
+FrameStore::FrameStore(int keyframe_interval, size_t cache_size)
+    : keyframe_interval(std::max(keyframe_interval, 1)), cache_size(std::max<size_t>(cache_size, 1)) {}
+
+void FrameStore::append_keyframe(const Frame& frame) {
+    Entry entry = {};
+    entry.keyframe = true;
+    entry.key = size();
+    entry.width = frame.get_width();
+    entry.height = frame.get_height();
+    entry.cells = key_cells.size();
+    entry.cell_count = static_cast<size_t>(entry.width) * entry.height;
+    entry.widths = key_line_widths.size();
+    entry.width_count = static_cast<size_t>(entry.height);
+    if (entry.cell_count > 0) {
+        key_cells.insert(key_cells.end(), frame.row(0), frame.row(0) + entry.cell_count);
+    }
+    for (int y = 0; y < entry.height; ++y) {
+        key_line_widths.push_back(frame.get_line_width(y));
+    }
+    entries.push_back(entry);
+}
+
+void FrameStore::append(const Frame& frame) {
+    bool keyframe = entries.empty() || size() - entries.back().key >= keyframe_interval ||
+                    frame.get_width() != last.get_width() || frame.get_height() != last.get_height();
+
+    if (!keyframe) {
+        // A delta costs more per cell than a keyframe, so stop diffing once it
+        // would no longer be smaller.
+        size_t limit = static_cast<size_t>(frame.get_width()) * frame.get_height() * sizeof(Cell) / sizeof(CellUpdate);
+        scratch.clear();
+        for (int y = 0; y < frame.get_height() && scratch.size() < limit; ++y) {
+            const Cell* before = last.row(y);
+            const Cell* after = frame.row(y);
+            for (int x = 0; x < frame.get_width(); ++x) {
+                if (!(before[x] == after[x])) {
+                    scratch.push_back({y, x, after[x]});
+                }
+            }
+        }
+        keyframe = scratch.size() >= limit;
+    }
+
+    if (keyframe) {
+        append_keyframe(frame);
+    } else {
+        Entry entry = {};
+        entry.keyframe = false;
+        entry.key = entries.back().key;
+        entry.width = frame.get_width();
+        entry.height = frame.get_height();
+        entry.cells = updates.size();
+        entry.cell_count = scratch.size();
+        entry.widths = line_width_updates.size();
+        updates.insert(updates.end(), scratch.begin(), scratch.end());
+        for (int y = 0; y < frame.get_height(); ++y) {
+            if (frame.get_line_width(y) != last.get_line_width(y)) {
+                line_width_updates.push_back({y, frame.get_line_width(y)});
+            }
+        }
+        entry.width_count = line_width_updates.size() - entry.widths;
+        entries.push_back(entry);
+    }
+    last = frame;
+}
+
+void FrameStore::finish() {
+    last = Frame();
+    scratch = {};
+    entries.shrink_to_fit();
+    key_cells.shrink_to_fit();
+    key_line_widths.shrink_to_fit();
+    updates.shrink_to_fit();
+    line_width_updates.shrink_to_fit();
+}
+
+bool FrameStore::advance(int index, Frame& frame, std::span<const CellUpdate>& changes) const {
+    const Entry& entry = entries[index];
+    if (entry.keyframe) {
+        const Cell* cells = entry.cell_count > 0 ? key_cells.data() + entry.cells : nullptr;
+        frame.assign(entry.width, entry.height, cells, key_line_widths.data() + entry.widths);
+        changes = {};
+        return true;
+    }
+    changes = std::span<const CellUpdate>(updates.data() + entry.cells, entry.cell_count);
+    frame.apply(changes);
+    for (size_t i = entry.widths; i < entry.widths + entry.width_count; ++i) {
+        frame.set_line_width(line_width_updates[i].y, line_width_updates[i].width);
+    }
+    // A line whose width changed is centered differently, so its old cells
+    // are not where the changes would put them.
+    return entry.width_count > 0;
+}
+
+void FrameStore::decode(int index, Frame& frame) const {
+    std::span<const CellUpdate> changes;
+    for (int at = entries[index].key; at <= index; ++at) {
+        advance(at, frame, changes);
+    }
+}
+
+std::shared_ptr<const Frame> FrameStore::get(int index) const {
+    if (index < 0 || index >= size()) {
+        throw std::out_of_range("Frame index out of range.");
+    }
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for (size_t i = 0; i < cache.size(); ++i) {
+        if (cache[i].index == index) {
+            std::rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+            return cache.front().frame;
+        }
+    }
+
+    // Start from the latest cached frame on the way from the keyframe, so
+    // playing forward applies one delta per frame.
+    int key = entries[index].key;
+    const CachedFrame* nearest = nullptr;
+    for (const auto& cached : cache) {
+        if (cached.index >= key && cached.index < index && (!nearest || cached.index > nearest->index)) {
+            nearest = &cached;
+        }
+    }
+    Frame frame;
+    if (nearest != nullptr) {
+        frame = *nearest->frame;
+        std::span<const CellUpdate> changes;
+        for (int at = nearest->index; at < index;) {
+            advance(++at, frame, changes);
+        }
+    } else {
+        decode(index, frame);
+    }
+
+    cache.insert(cache.begin(), {index, std::make_shared<const Frame>(std::move(frame))});
+    if (cache.size() > cache_size) {
+        cache.pop_back();
+    }
+    return cache.front().frame;
+}
+
+size_t FrameStore::get_memory_usage() const {
+    return entries.capacity() * sizeof(Entry) + key_cells.capacity() * sizeof(Cell) +
+           key_line_widths.capacity() * sizeof(std::int32_t) + updates.capacity() * sizeof(CellUpdate) +
+           line_width_updates.capacity() * sizeof(LineWidthUpdate) + last.get_memory_usage();
+}
+
+std::shared_ptr<const StoredAnimation> store_animation(const Animator& animator, const Config& config) {
+    int interval = config.keyframe_interval > 0 ? config.keyframe_interval : kDefaultKeyframeInterval;
+    auto animation = std::make_shared<StoredAnimation>(interval);
+
+    Config pass_config = config;
+    pass_config.loop = false;
+    pass_config.pipeline_depth = 0;
+    Sequencer sequencer(animator, pass_config);
+    Tick tick;
+    while (sequencer.next(tick)) {
+        animation->frames.append(*tick.frame);
+        animation->hold_ms.push_back(static_cast<std::uint32_t>(tick.hold.count()));
+    }
+    if (animation->frames.size() == 0) {
+        throw std::runtime_error("Animation has no frames to store.");
+    }
+    animation->frames.finish();
+    return animation;
+}
+
+StoredPlayer::StoredPlayer(std::shared_ptr<const StoredAnimation> animation, const Config& config)
+    : animation(std::move(animation)),
+      loop(config.loop),
+      loop_pause_ms(static_cast<std::uint32_t>(config.loop_pause_ms)) {}
+
+bool StoredPlayer::next(Tick& tick) {
+    int count = animation->frames.size();
+    if (played == count) {
+        if (!loop) {
+            return false;
+        }
+        played = 0;
+    }
+
+    tick.full = animation->frames.advance(played, shown, tick.changes);
+    tick.frame = &shown;
+    tick.hold = std::chrono::milliseconds(animation->hold_ms[played]);
+
+    // The last tick of a pass carries the pause before looping.
+    if (++played == count && loop) {
+        tick.hold = std::chrono::milliseconds(loop_pause_ms);
+    }
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef FRAME_FRAME_STORE_H
+#define FRAME_FRAME_STORE_H
+
+#include "frame.h"
+#include "sequencer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+class Animator;
+struct Config;
+
+// Keyframe interval used when a store is wanted but none was configured.
+constexpr int kDefaultKeyframeInterval = 64;
+
+// A sequence of frames held as periodic keyframes plus the cells that change
+// between consecutive frames. Flip-book frames and interpolation steps usually
+// differ in a few cells, so a long sequence takes a fraction of the memory of
+// full frames. Frames are decoded on demand; the last few are cached.
+class FrameStore {
+public:
+    // A full frame is kept at least every `keyframe_interval` frames, which
+    // bounds how many deltas a random access has to apply.
+    explicit FrameStore(int keyframe_interval, size_t cache_size = 4);
+
+    // Adds a frame after the last one. A frame is stored whole when it starts a
+    // new interval, changes size, or differs from the previous frame in so many
+    // cells that the delta would be no smaller. Not safe to call while other
+    // threads read the store.
+    void append(const Frame& frame);
+
+    // Releases what appending needs once the last frame is in. Appending
+    // afterwards starts with a keyframe.
+    void finish();
+
+    int size() const { return static_cast<int>(entries.size()); }
+
+    // Decodes frame `index`, starting from the nearest cached frame or keyframe.
+    std::shared_ptr<const Frame> get(int index) const;
+
+    // Decodes frame `index` into `frame`, starting from its keyframe. Unlike
+    // get, nothing is cached or allocated once `frame` has the right size.
+    void decode(int index, Frame& frame) const;
+
+    // Turns `frame`, which must hold frame `index - 1` (or anything, when
+    // `index` is a keyframe), into frame `index`. Returns true if `frame` has
+    // to be drawn whole: `index` is a keyframe, or its line widths changed and
+    // so lines moved. Otherwise `changes` is set to the cells that were
+    // written, valid for the life of the store.
+    bool advance(int index, Frame& frame, std::span<const CellUpdate>& changes) const;
+
+    // Approximate heap memory held by the encoded frames, in bytes.
+    size_t get_memory_usage() const;
+
+private:
+    struct LineWidthUpdate {
+        std::int32_t y;
+        std::int32_t width;
+    };
+
+    // Keyframes index `key_cells` and `key_line_widths`; deltas index `updates`
+    // and `line_width_updates`.
+    struct Entry {
+        bool keyframe;
+        int key;         // Index of the keyframe this frame is decoded from
+        int width;
+        int height;
+        size_t cells;    // First cell or update
+        size_t cell_count;
+        size_t widths;   // First line width or line width update
+        size_t width_count;
+    };
+
+    void append_keyframe(const Frame& frame);
+
+    int keyframe_interval;
+    size_t cache_size;
+    std::vector<Entry> entries;
+    std::vector<Cell> key_cells;
+    std::vector<std::int32_t> key_line_widths;
+    std::vector<CellUpdate> updates;
+    std::vector<LineWidthUpdate> line_width_updates;
+    Frame last;                      // The last frame appended, to diff the next one against
+    std::vector<CellUpdate> scratch; // Delta being built by append
+
+    struct CachedFrame {
+        int index;
+        std::shared_ptr<const Frame> frame;
+    };
+    mutable std::mutex cache_mutex;
+    mutable std::vector<CachedFrame> cache; // Most recently used first
+};
+
+// One pass of an animation generated up front: every tick in a FrameStore,
+// with the pause that follows it.
+struct StoredAnimation {
+    explicit StoredAnimation(int keyframe_interval) : frames(keyframe_interval) {}
+
+    FrameStore frames;
+    std::vector<std::uint32_t> hold_ms;
+};
+
+// Plays the sequence once (ignoring `loop`) and stores every tick, using
+// `keyframe_interval` from the config or kDefaultKeyframeInterval.
+std::shared_ptr<const StoredAnimation> store_animation(const Animator& animator, const Config& config);
+
+// Plays a stored animation with no frame generation. Between keyframes the
+// stored deltas are handed to the renderer as the tick's changes.
+class StoredPlayer : public TickSource {
+public:
+    StoredPlayer(std::shared_ptr<const StoredAnimation> animation, const Config& config);
+
+    bool next(Tick& tick) override;
+
+private:
+    std::shared_ptr<const StoredAnimation> animation;
+    int played = 0;
+    bool loop;
+    std::uint32_t loop_pause_ms;
+    Frame shown;
+};
+
+#endif //FRAME_FRAME_STORE_H
@@ -0,0 +1,114 @@
+#include "frame_stream.h"
+#include <utility>
+
+FrameStream::FrameStream(std::vector<std::string> paths, int window, size_t memory_cap, bool loop)
+    : paths(std::move(paths)),
+      window(window > 0 ? window : 1),
+      memory_cap(memory_cap),
+      loop(loop),
+      resident(this->paths.size()),
+      loading(this->paths.size(), false),
+      versions(this->paths.size(), 0) {
+    loader = std::thread(&FrameStream::run, this);
+}
+
+FrameStream::~FrameStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    loader.join();
+}
+
+bool FrameStream::wanted(int index) const {
+    int count = size();
+    // The frames ahead of the playhead, wrapping around when looping.
+    int distance = index - playhead;
+    if (distance < 0 && loop) {
+        distance += count;
+    }
+    if (distance >= 0 && distance < window) {
+        return true;
+    }
+    // Looping comes back to the start, so the first window is kept for reuse.
+    return loop && index < window;
+}
+
+int FrameStream::next_to_load() const {
+    int count = size();
+    for (int k = 0; k < window && k < count; ++k) {
+        int index = playhead + k;
+        if (index >= count) {
+            if (!loop) {
+                break;
+            }
+            index -= count;
+        }
+        if (resident[index] || loading[index]) {
+            continue;
+        }
+        // The frame at the playhead is always loaded; the rest must fit the cap.
+        if (k > 0 && resident_bytes >= memory_cap) {
+            return -1;
+        }
+        return index;
+    }
+    return -1;
+}
+
+void FrameStream::evict() {
+    for (int index = 0; index < size(); ++index) {
+        if (resident[index] && !wanted(index)) {
+            resident_bytes -= resident[index]->get_memory_usage();
+            resident[index].reset();
+        }
+    }
+}
+
+void FrameStream::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        int index = next_to_load();
+        if (index < 0) {
+            changed.wait(lock);
+            continue;
+        }
+
+        // Load outside the lock so the playback thread is never held up by disk reads.
+        loading[index] = true;
+        unsigned version = versions[index];
+        lock.unlock();
+        auto frame = std::make_shared<const Frame>(paths[index]);
+        lock.lock();
+        loading[index] = false;
+        if (versions[index] != version) {
+            continue; // The file changed while it was being read; read it again.
+        }
+
+        resident[index] = std::move(frame);
+        resident_bytes += resident[index]->get_memory_usage();
+        changed.notify_all();
+    }
+}
+
+void FrameStream::reload(int index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++versions[index];
+    if (resident[index]) {
+        resident_bytes -= resident[index]->get_memory_usage();
+        resident[index].reset();
+    }
+    changed.notify_all();
+}
+
+std::shared_ptr<const Frame> FrameStream::get(int index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (index != playhead) {
+        playhead = index;
+        evict();
+        changed.notify_all();
+    }
+    changed.wait(lock, [&] { return resident[index] != nullptr; });
+    return resident[index];
+}
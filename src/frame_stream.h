@@ -0,0 +1,62 @@
+#ifndef FRAME_FRAME_STREAM_H
+#define FRAME_FRAME_STREAM_H
+
+#include "frame.h"
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads a long list of frame files on a background thread, a small window
+// ahead of the playhead, and drops frames once they have been played. Only
+// the window (and, when looping, the first window) stays resident, so memory
+// does not grow with the length of the sequence.
+class FrameStream {
+public:
+    // `window` is how many frames to keep loaded from the playhead onwards.
+    // Prefetching stops early once the resident frames reach `memory_cap` bytes.
+    FrameStream(std::vector<std::string> paths, int window, size_t memory_cap, bool loop);
+    ~FrameStream();
+
+    // Returns frame `index`, loading it first if it is not resident yet, and
+    // moves the playhead there. The frame stays valid for as long as the caller
+    // holds the pointer, even after the stream evicts it.
+    std::shared_ptr<const Frame> get(int index);
+
+    int size() const { return static_cast<int>(paths.size()); }
+
+    // Drops frame `index` so it is read from disk again the next time it is
+    // wanted. A load of it already under way is discarded.
+    void reload(int index);
+
+private:
+    void run();
+
+    // Whether frame `index` belongs in memory for the current playhead.
+    bool wanted(int index) const;
+
+    // Index of the next frame worth prefetching, or -1 if there is nothing to do.
+    int next_to_load() const;
+
+    void evict();
+
+    const std::vector<std::string> paths;
+    const int window;
+    const size_t memory_cap;
+    const bool loop;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::shared_ptr<const Frame>> resident;
+    std::vector<bool> loading;
+    std::vector<unsigned> versions; // Bumped by reload, so stale loads can be told apart
+    size_t resident_bytes = 0;
+    int playhead = 0;
+    bool stopping = false;
+    std::thread loader;
+};
+
+#endif //FRAME_FRAME_STREAM_H
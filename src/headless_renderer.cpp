@@ -0,0 +1,68 @@
+#include "headless_renderer.h"
+#include "frame.h"
+#include "stage_stats.h"
+#include <algorithm>
+
+HeadlessRenderer::HeadlessRenderer(int rows, int cols)
+    : rows(rows), cols(cols), screen(static_cast<size_t>(rows) * cols, kBlankCell) {}
+
+void HeadlessRenderer::clear_screen() {
+    std::fill(screen.begin(), screen.end(), kBlankCell);
+    layout.clear();
+}
+
+void HeadlessRenderer::put_cell(int y, int x, const Cell& cell) {
+    // Clip to the screen, the way a terminal plane would.
+    if (y < 0 || y >= rows || x < 0 || x >= cols) {
+        return;
+    }
+    Cell* row = screen.data() + static_cast<size_t>(y) * cols;
+    row[x] = cell;
+    if (cell.width == 2 && x + 1 < cols) {
+        row[x + 1] = {U' ', 0};
+    }
+    ++cells_written;
+}
+
+void HeadlessRenderer::draw_frame(const Frame& frame) {
+    if (frame.get_height() == 0 || frame.get_width() == 0) {
+        return; // Don't attempt to draw an empty or unloaded frame
+    }
+    StageTimer timer(Stage::draw);
+
+    if (frame.get_height() > rows || frame.get_width() > cols) {
+        rows = std::max(rows, frame.get_height());
+        cols = std::max(cols, frame.get_width());
+        screen.resize(static_cast<size_t>(rows) * cols);
+        layout.clear();
+    }
+
+    std::fill(screen.begin(), screen.end(), kBlankCell);
+    if (!layout.matches(frame)) {
+        layout.compute(frame, rows, cols);
+    }
+
+    for (int y = 0; y < frame.get_height(); ++y) {
+        const Cell* cells = frame.row(y);
+        for (int x = 0; x < layout.line_widths[y]; ++x) {
+            if (cells[x].width == 0) {
+                continue; // Right half of a wide glyph, already drawn.
+            }
+            put_cell(layout.origin_y + y, layout.line_x[y] + x, cells[x]);
+        }
+    }
+}
+
+void HeadlessRenderer::draw_changes(const Frame& frame, std::span<const CellUpdate> changes) {
+    if (!layout.matches(frame)) {
+        draw_frame(frame);
+        return;
+    }
+    StageTimer timer(Stage::draw);
+    for (const auto& change : changes) {
+        if (change.cell.width == 0) {
+            continue; // Covered by the wide glyph to its left.
+        }
+        put_cell(layout.origin_y + change.y, layout.line_x[change.y] + change.x, change.cell);
+    }
+}
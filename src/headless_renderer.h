@@ -0,0 +1,46 @@
+#ifndef FRAME_HEADLESS_RENDERER_H
+#define FRAME_HEADLESS_RENDERER_H
+
+#include "cell.h"
+#include "renderer.h"
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Draws frames into an in-memory screen instead of a terminal. Used by the
+// benchmark mode and anywhere else playback has to run without a TTY.
+class HeadlessRenderer : public Renderer {
+public:
+    // The screen starts at the given size and grows whenever a frame would not fit.
+    HeadlessRenderer(int rows, int cols);
+
+    void clear_screen() override;
+    void draw_frame(const Frame& frame) override;
+    void draw_changes(const Frame& frame, std::span<const CellUpdate> changes) override;
+
+    // There is no keyboard: waiting for quit returns immediately and quit is never requested.
+    void wait_for_quit() override {}
+    bool wait_for_quit_until(std::chrono::steady_clock::time_point deadline) override {
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+
+    // The screen contents, row-major, `get_cols()` cells per row.
+    const std::vector<Cell>& get_screen() const { return screen; }
+    int get_rows() const { return rows; }
+    int get_cols() const { return cols; }
+
+    // Total number of cells written since construction.
+    std::uint64_t get_cells_written() const { return cells_written; }
+
+private:
+    void put_cell(int y, int x, const Cell& cell);
+
+    int rows;
+    int cols;
+    std::vector<Cell> screen;
+    FrameLayout layout;
+    std::uint64_t cells_written = 0;
+};
+
+#endif //FRAME_HEADLESS_RENDERER_H
@@ -1,10 +1,38 @@
 #include "config.h"
 #include "frame.h"
-#include "renderer.h"
 #include "animator.h"
+#include "baked.h"
+#include "compositor.h"
+#include "exporter.h"
+#include "file_watcher.h"
+#include "frame_store.h"
+#include "headless_renderer.h"
+#include "notcurses_renderer.h"
+#include "terminal_renderer.h"
+#include "scheduler.h"
+#include "stage_stats.h"
+#include "sequencer.h"
+#include <algorithm>
 #include <iostream>
-#include <thread>
 #include <chrono>
+#include <clocale> // For setlocale
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <sys/resource.h> // For getrusage
+
+// Opens the terminal backend named by `config.renderer`.
+std::unique_ptr<Renderer> open_renderer(const Config& config) {
+    if (config.renderer == "notcurses") {
+        return std::make_unique<NotcursesRenderer>();
+    }
+    if (config.renderer == "ansi") {
+        return std::make_unique<TerminalRenderer>();
+    }
+    throw std::runtime_error("Unknown renderer: " + config.renderer + " (expected notcurses or ansi)");
+}
 
 void run_static_mode(const Config& config) {
     if (config.frame_paths.empty()) {
@@ -15,79 +43,375 @@ void run_static_mode(const Config& config) {
     if (frame.get_height() == 0) {
         exit(1);
     }
-    Renderer renderer;
-    renderer.clear_screen();
-    renderer.draw_frame(frame);
-    renderer.wait_for_quit();
+    try {
+        auto renderer = open_renderer(config);
+        renderer->clear_screen();
+        renderer->draw_frame(frame);
+        renderer->wait_for_quit();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        exit(1);
+    }
 }
 
-void run_animation_mode(const Config& config) {
-    try {
-        Animator animator(config);
-        if (animator.get_frame_count() < 2) {
-            std::cerr << "Error: Animation modes require at least two frames." << std::endl;
-            exit(1);
+// Draws one tick, either in full or as a list of changed cells.
+void present(Renderer& renderer, const Tick& tick) {
+    if (tick.full) {
+        renderer.draw_frame(*tick.frame);
+    } else {
+        renderer.draw_changes(*tick.frame, tick.changes);
+    }
+}
+
+// Everything needed to play an animation: the frames it was loaded from (if
+// any), the source that hands out its ticks, and how many ticks per second to show.
+struct Playback {
+    std::unique_ptr<Animator> animator;
+    std::shared_ptr<const StoredAnimation> stored; // One pass generated up front, with `precompute`
+    std::unique_ptr<TickSource> source;
+    int rate = 1;
+};
+
+// Starts a fresh pass over the animation: all layers composited together when
+// there are layers, the stored pass when it was generated up front, from the
+// baked file when there are no loaded frames, otherwise generated live from
+// the animator.
+std::unique_ptr<TickSource> open_source(const Config& config, const Playback& playback) {
+    if (!config.layers.empty()) {
+        return std::make_unique<Compositor>(config);
+    }
+    if (playback.stored) {
+        return std::make_unique<StoredPlayer>(playback.stored, config);
+    }
+    if (!playback.animator) {
+        return std::make_unique<BakedPlayer>(config.baked_path, config);
+    }
+    return make_tick_source(*playback.animator, config);
+}
+
+// Opens the layers if there are any, or a baked animation if one was given,
+// otherwise loads the frame files (sharing those `previous` already loaded)
+// and generates the sequence live, or up front with `precompute`.
+Playback open_playback(const Config& config, const Animator* previous = nullptr) {
+    Playback playback;
+    playback.rate = config.frame_rate;
+    if (!config.layers.empty()) {
+        auto compositor = std::make_unique<Compositor>(config);
+        playback.rate = compositor->get_tick_rate();
+        playback.source = std::move(compositor);
+        return playback;
+    }
+    if (!config.baked_path.empty()) {
+        playback.source = std::make_unique<BakedPlayer>(config.baked_path, config);
+        return playback;
+    }
+
+    playback.animator = std::make_unique<Animator>(config, previous);
+    if (config.precompute) {
+        playback.stored = store_animation(*playback.animator, config);
+    }
+    playback.source = open_source(config, playback);
+    return playback;
+}
+
+// Prints the timing and stage report to stderr, or writes it as JSON when a
+// stats file was given.
+void report_stats(const Config& config, const TimingStats& timing) {
+    if (config.stats_path.empty()) {
+        timing.print(std::cerr);
+        print_stage_stats(std::cerr);
+        return;
+    }
+    std::ofstream out(config.stats_path);
+    if (!out) {
+        std::cerr << "Error: Could not write stats to " << config.stats_path << std::endl;
+        return;
+    }
+    write_stats_json(out, timing);
+}
+
+// The files a live reload watches: the config file and every frame file it names.
+std::vector<std::string> watched_files(const Config& config) {
+    std::vector<std::string> paths = config.frame_paths;
+    for (const auto& layer : config.layers) {
+        paths.insert(paths.end(), layer.config.frame_paths.begin(), layer.config.frame_paths.end());
+    }
+    paths.push_back(config.config_file);
+    return paths;
+}
+
+// Picks up edits to the frame files and the config file while playing.
+class LiveReload {
+public:
+    // `reparse` reads the config again, the same way it was read at startup.
+    LiveReload(const Config& config, std::function<Config()> reparse)
+        : reparse(std::move(reparse)), watcher(std::make_unique<FileWatcher>(watched_files(config))) {}
+
+    // Applies the edits seen since the last call. Edited frame files are
+    // reparsed one at a time and swapped into the animator. An edited config
+    // file (or any edit when playing layers or a precomputed pass) reopens playback with the new
+    // settings, sharing every frame that did not change. Returns true if
+    // playback was reopened. Edits that do not parse or load are ignored until
+    // they are fixed.
+    bool apply(Config& config, Playback& playback) {
+        std::vector<std::string> changed = watcher->poll();
+        if (changed.empty()) {
+            return false;
+        }
+        // Frames first, so a reopened playback shares their new versions.
+        if (playback.animator) {
+            for (const auto& path : changed) {
+                playback.animator->reload_frame(path);
+            }
         }
+        bool config_changed = std::find(changed.begin(), changed.end(), config.config_file) != changed.end();
+        if (!config_changed && config.layers.empty() && !config.precompute) {
+            return false;
+        }
+
+        Config updated = config;
+        if (config_changed) {
+            try {
+                static_cast<void>(toml::parse_file(config.config_file));
+            } catch (const toml::parse_error&) {
+                return false;
+            }
+            updated = reparse();
+        }
+        try {
+            Playback reopened = open_playback(updated, playback.animator.get());
+            playback = std::move(reopened);
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        config = std::move(updated);
+        watcher = std::make_unique<FileWatcher>(watched_files(config));
+        return true;
+    }
 
-        Renderer renderer;
-        renderer.clear_screen();
+private:
+    std::function<Config()> reparse;
+    std::unique_ptr<FileWatcher> watcher;
+};
 
-        auto frame_duration = std::chrono::milliseconds(1000 / config.frame_rate);
-        auto pause_duration = std::chrono::milliseconds(config.pause_ms);
-        auto loop_pause_duration = std::chrono::milliseconds(config.loop_pause_ms);
-        bool quit_requested = false;
+void run_animation_mode(const Config& initial_config, const std::function<Config()>& reparse) {
+    try {
+        Config config = initial_config;
+        Playback playback = open_playback(config);
+        TickSource* source = playback.source.get();
+        FrameScheduler scheduler(playback.rate, parse_late_policy(config.late_policy));
 
-        do { // Main loop for the whole animation, handles the 'loop' config
-            // Loop through pairs of frames (F1->F2, F2->F3, etc.)
-            for (int i = 0; i < animator.get_frame_count() - 1; ++i) {
-                const Frame& start_frame = animator.get_frame(i);
-                const Frame& end_frame = animator.get_frame(i + 1);
-                int total_interp_steps = config.steps;
+        std::unique_ptr<LiveReload> live_reload;
+        if (config.watch) {
+            live_reload = std::make_unique<LiveReload>(config, reparse);
+        }
+        TimingStats timing;
 
-                // The interpolation loop for a single segment
-                for (int step = 0; step <= total_interp_steps; ++step) {
-                    auto start_time = std::chrono::steady_clock::now();
+        {
+            auto renderer = open_renderer(config);
+            renderer->clear_screen();
 
-                    Frame current_frame = animator.generate_interpolated_frame(start_frame, end_frame, step, total_interp_steps);
-                    renderer.draw_frame(current_frame);
+            bool quit_requested = false;
 
-                    if (renderer.check_for_quit()) {
-                        quit_requested = true;
-                        break;
-                    }
+            // Changes carried over from frames dropped by the scheduler, drawn
+            // together with the next frame that is shown.
+            std::vector<CellUpdate> carried;
+            bool carried_full = false;
 
-                    auto end_time = std::chrono::steady_clock::now();
-                    auto render_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-                    auto sleep_time = frame_duration - render_time;
+            // A copy of the frame on screen. The renderer redraws it on a resize
+            // while the next tick waits for its deadline, by which time the
+            // source has already moved on from (or freed) the frame it handed out.
+            Frame shown;
+
+            // Main loop for the whole animation. The tick source walks the frame pairs
+            // (F1->F2, F2->F3, etc.), their interpolation steps and the 'loop' config;
+            // the scheduler decides when each frame is shown.
+            Tick tick;
+            scheduler.start();
+            while (source->next(tick)) {
+                if (scheduler.should_drop()) {
+                    carried_full = carried_full || tick.full;
+                    if (!carried_full) {
+                        carried.insert(carried.end(), tick.changes.begin(), tick.changes.end());
+                    }
+                    scheduler.drop(tick.hold);
+                    continue;
+                }
 
-                    if (sleep_time > std::chrono::milliseconds(0)) {
-                        std::this_thread::sleep_for(sleep_time);
+                if (carried_full || !carried.empty()) {
+                    tick.full = tick.full || carried_full;
+                    if (!tick.full) {
+                        carried.insert(carried.end(), tick.changes.begin(), tick.changes.end());
+                        tick.changes = carried;
                     }
-                } // End interpolation loop
+                }
 
-                if (quit_requested) break;
+                // Input and resizes are handled while waiting, so quit is
+                // immediate even during long pauses.
+                if (renderer->wait_for_quit_until(scheduler.get_deadline())) {
+                    quit_requested = true;
+                    break;
+                }
+                if (tick.full) {
+                    shown = *tick.frame;
+                } else {
+                    shown.apply(tick.changes);
+                }
+                tick.frame = &shown;
+                present(*renderer, tick);
+                scheduler.presented(tick.hold);
+                carried.clear();
+                carried_full = false;
 
-                // Handle pause between interpolations, but only if not on the last frame and pause is configured
-                if (i < animator.get_frame_count() - 2 && pause_duration > std::chrono::milliseconds(0)) {
-                    std::this_thread::sleep_for(pause_duration);
+                // Edits are swapped in between steps; a reopened playback
+                // starts over on a fresh schedule.
+                if (live_reload && live_reload->apply(config, playback)) {
+                    source = playback.source.get();
+                    scheduler.set_frame_rate(playback.rate);
+                    scheduler.start();
                 }
+            }
+
+            // If the animation completes without being quit, wait for a final quit command.
+            if (!quit_requested) {
+                renderer->wait_for_quit();
+            }
+            timing = scheduler.get_stats();
+            timing.output_bytes = renderer->get_bytes_written();
+        }
+
+        // Reported once the terminal has been restored, so it stays on screen.
+        if (config.show_stats) {
+            report_stats(config, timing);
+        }
+
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        exit(1);
+    }
+}
+
+// Plays the whole frame sequence into a headless renderer, with no sleeps or
+// input polling, and reports throughput. Runs without a terminal.
+void run_bench_mode(const Config& config) {
+    try {
+        // Each pass plays the sequence once; looping would never finish.
+        Config pass_config = config;
+        pass_config.loop = false;
+        for (auto& layer : pass_config.layers) {
+            layer.config.loop = false;
+        }
 
-            } // End frame-pair loop
+        // The in-memory screen grows to fit the frames, so nothing is clipped.
+        Playback playback = open_playback(pass_config);
+        HeadlessRenderer renderer(0, 0);
 
-            if (quit_requested) break;
+        using bench_clock = std::chrono::steady_clock;
+        std::chrono::nanoseconds generate_time{0};
+        std::chrono::nanoseconds draw_time{0};
+        std::uint64_t frames = 0;
+        std::uint64_t cells = 0;
 
-            // If looping, handle the pause between loops
-            if (config.loop && !quit_requested && loop_pause_duration > std::chrono::milliseconds(0)) {
-                std::this_thread::sleep_for(loop_pause_duration);
+        auto bench_start = bench_clock::now();
+        for (int pass = 0; pass < config.bench_passes; ++pass) {
+            if (pass > 0) {
+                playback.source = open_source(pass_config, playback);
             }
+            TickSource* source = playback.source.get();
+            Tick tick;
+            while (true) {
+                auto t0 = bench_clock::now();
+                if (!source->next(tick)) {
+                    break;
+                }
+                auto t1 = bench_clock::now();
+                present(renderer, tick);
+                auto t2 = bench_clock::now();
+
+                generate_time += t1 - t0;
+                draw_time += t2 - t1;
+                ++frames;
+                cells += static_cast<std::uint64_t>(tick.frame->get_width()) * tick.frame->get_height();
+            }
+        }
+        std::chrono::duration<double> elapsed = bench_clock::now() - bench_start;
+
+        struct rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+
+        auto per_cell = [cells](std::chrono::nanoseconds t) {
+            return cells > 0 ? static_cast<double>(t.count()) / cells : 0.0;
+        };
+        std::cout << "frames:          " << frames << "\n"
+                  << "elapsed:         " << elapsed.count() * 1000.0 << " ms\n"
+                  << "frames/sec:      " << (elapsed.count() > 0 ? frames / elapsed.count() : 0.0) << "\n"
+                  << "generate:        " << per_cell(generate_time) << " ns/cell\n"
+                  << "draw:            " << per_cell(draw_time) << " ns/cell\n"
+                  << "cells written:   " << renderer.get_cells_written() << "\n"
+                  << "peak memory:     " << usage.ru_maxrss << " KiB" << std::endl;
 
-        } while (config.loop);
+        // The benchmark has no schedule, so only the frame count carries over.
+        if (config.show_stats) {
+            TimingStats timing;
+            timing.presented = frames;
+            report_stats(config, timing);
+        }
+
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        exit(1);
+    }
+}
+
+// Plays the animation once without a terminal or sleeps and records the
+// terminal output to a file, timestamped as if it had been played live.
+void run_export_mode(const Config& config) {
+    try {
+        // A looping animation would never finish, and the export is reproducible
+        // by default, like a bake.
+        Config export_config = config;
+        export_config.loop = false;
+        for (auto& layer : export_config.layers) {
+            layer.config.loop = false;
+        }
+        if (!export_config.seed) {
+            export_config.seed = kDefaultBakeSeed;
+        }
+        ExportFormat format = parse_export_format(config.export_format, config.export_path);
+
+        Playback playback = open_playback(export_config);
+        auto start = std::chrono::steady_clock::now();
+        ExportSummary summary = export_animation(*playback.source, playback.rate, format, config.export_path);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
 
-        // If the animation completes without being quit, wait for a final quit command.
-        if (!quit_requested) {
-            renderer.wait_for_quit();
+        std::cout << "Exported " << summary.frames << " frames (" << summary.cols << "x" << summary.rows << ", "
+                  << summary.duration << " s) to " << config.export_path << " in " << elapsed.count() * 1000.0
+                  << " ms, " << summary.bytes << " bytes of output" << std::endl;
+
+        if (config.show_stats) {
+            TimingStats timing;
+            timing.presented = summary.frames;
+            report_stats(config, timing);
         }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        exit(1);
+    }
+}
 
+// Writes the fully expanded animation to a baked file for fast playback.
+void run_bake_mode(const Config& config) {
+    if (config.output_path.empty()) {
+        std::cerr << "Error: 'frame bake' requires an output file (-o)." << std::endl;
+        exit(1);
+    }
+    try {
+        Config bake_config = config;
+        if (!bake_config.seed) {
+            bake_config.seed = kDefaultBakeSeed;
+        }
+        Animator animator(bake_config);
+        bake_animation(animator, bake_config, config.output_path);
     } catch (const std::runtime_error& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         exit(1);
@@ -95,12 +419,26 @@ void run_animation_mode(const Config& config) {
 }
 
 int main(int argc, char** argv) {
+    // Set the global C locale from the user's environment before any frame is
+    // loaded. Frame decoding relies on it to look up the display width of wide
+    // and combining characters.
+    std::setlocale(LC_ALL, "");
+
     Config config = parse_config(argc, argv);
+    if (config.show_stats) {
+        enable_stage_stats();
+    }
 
-    if (config.mode == "static") {
+    if (config.bench_passes > 0) {
+        run_bench_mode(config);
+    } else if (!config.export_path.empty()) {
+        run_export_mode(config);
+    } else if (config.mode == "bake") {
+        run_bake_mode(config);
+    } else if (config.mode == "static") {
         run_static_mode(config);
     } else if (config.mode == "sequence" || config.mode == "interpolate") {
-        run_animation_mode(config);
+        run_animation_mode(config, [argc, argv] { return parse_config(argc, argv); });
     } else {
         std::cerr << "Error: Unknown mode '" << config.mode << "'" << std::endl;
         return 1;
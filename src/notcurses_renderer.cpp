@@ -0,0 +1,255 @@
+#include "notcurses_renderer.h"
+#include "frame.h" // The full definition of Frame is needed here
+#include "stage_stats.h"
+#include <cstdint>
+#include <cstdlib> // For free
+#include <iostream>
+#include <thread>
+#include <notcurses/notcurses.h>
+#include <poll.h> // For poll
+
+NotcursesRenderer::NotcursesRenderer() : frame_plane(nullptr), plane_rows(0), plane_cols(0), input_fd(-1) {
+    notcurses_options opts = {};
+    // NCOPTION_SUPPRESS_BANNERS: Don't show Notcurses startup/shutdown messages.
+    opts.flags = NCOPTION_SUPPRESS_BANNERS;
+
+    nc = notcurses_init(&opts, NULL);
+    if (nc == NULL) {
+        std::cerr << "Error: Could not initialize Notcurses." << std::endl;
+        exit(1);
+    }
+    stdplane = notcurses_stdplane(nc);
+
+    // Create a single plane that covers the entire screen. It is reused for
+    // every frame and only resized when the terminal size changes.
+    notcurses_term_dim_yx(nc, &plane_rows, &plane_cols);
+    ncplane_options nopts = {};
+    nopts.y = 0;
+    nopts.x = 0;
+    nopts.rows = plane_rows;
+    nopts.cols = plane_cols;
+
+    frame_plane = ncplane_create(stdplane, &nopts);
+    if (frame_plane == NULL) {
+        std::cerr << "Error: Could not create the frame plane." << std::endl;
+        notcurses_stop(nc);
+        exit(1);
+    }
+
+    // Input and resize events are waited for on this descriptor instead of
+    // being polled for on every frame.
+    input_fd = notcurses_inputready_fd(nc);
+}
+
+NotcursesRenderer::~NotcursesRenderer() {
+    if (nc) {
+        if (frame_plane) {
+            ncplane_destroy(frame_plane);
+        }
+        notcurses_stop(nc);
+    }
+}
+
+std::uint64_t NotcursesRenderer::get_bytes_written() const {
+    ncstats* stats = notcurses_stats_alloc(nc);
+    if (stats == nullptr) {
+        return 0;
+    }
+    notcurses_stats(nc, stats);
+    auto bytes = static_cast<std::uint64_t>(stats->raster_bytes);
+    free(stats);
+    return bytes;
+}
+
+void NotcursesRenderer::clear_screen() {
+    ncplane_erase(frame_plane);
+    ncplane_erase(stdplane);
+    layout.clear();
+    notcurses_render(nc);
+}
+
+bool NotcursesRenderer::fit_plane_to_terminal() {
+    unsigned int term_dim_y, term_dim_x;
+    notcurses_term_dim_yx(nc, &term_dim_y, &term_dim_x);
+    if (term_dim_y == plane_rows && term_dim_x == plane_cols) {
+        return false;
+    }
+    ncplane_resize_simple(frame_plane, term_dim_y, term_dim_x);
+    plane_rows = term_dim_y;
+    plane_cols = term_dim_x;
+    return true;
+}
+
+void NotcursesRenderer::set_attributes(const Cell& cell) {
+    if (attributes_known && cell.fg == plane_fg && cell.bg == plane_bg && cell.style == plane_style) {
+        return;
+    }
+    attributes_known = true;
+    plane_fg = cell.fg;
+    plane_bg = cell.bg;
+    plane_style = cell.style;
+
+    // Notcurses has no reverse video, so the colors are swapped instead, with
+    // black and white standing in for the defaults. Dim and blink have no
+    // Notcurses style and are dropped.
+    std::uint32_t fg = cell.fg;
+    std::uint32_t bg = cell.bg;
+    if (cell.style & kStyleReverse) {
+        fg = cell.bg == kDefaultColor ? 0x000000 : cell.bg;
+        bg = cell.fg == kDefaultColor ? 0xffffff : cell.fg;
+    }
+    if (fg == kDefaultColor) {
+        ncplane_set_fg_default(frame_plane);
+    } else {
+        ncplane_set_fg_rgb(frame_plane, fg);
+    }
+    if (bg == kDefaultColor) {
+        ncplane_set_bg_default(frame_plane);
+    } else {
+        ncplane_set_bg_rgb(frame_plane, bg);
+    }
+
+    unsigned styles = NCSTYLE_NONE;
+    if (cell.style & kStyleBold) styles |= NCSTYLE_BOLD;
+    if (cell.style & kStyleItalic) styles |= NCSTYLE_ITALIC;
+    if (cell.style & kStyleUnderline) styles |= NCSTYLE_UNDERLINE;
+    if (cell.style & kStyleStrike) styles |= NCSTYLE_STRUCK;
+    ncplane_set_styles(frame_plane, styles);
+}
+
+void NotcursesRenderer::put_cell(int y, int x, const Cell& cell) {
+    // Attributes go straight onto the plane; no escape text is built or parsed.
+    set_attributes(cell);
+    glyph_buffer.clear();
+    append_glyph_utf8(cell.glyph, glyph_buffer);
+    ncplane_putegc_yx(frame_plane, y, x, glyph_buffer.c_str(), nullptr);
+}
+
+void NotcursesRenderer::draw_frame(const Frame& frame) {
+    last_frame = &frame;
+    int frame_height = frame.get_height();
+    int frame_width = frame.get_width();
+
+    if (frame_height == 0 || frame_width == 0) {
+        return; // Don't attempt to draw an empty or unloaded frame
+    }
+
+    {
+        StageTimer timer(Stage::draw);
+        ncplane_erase(frame_plane);
+        // The layout only changes when the terminal is resized or the frame's
+        // line widths differ from the last one.
+        if (!layout.matches(frame)) {
+            layout.compute(frame, static_cast<int>(plane_rows), static_cast<int>(plane_cols));
+        }
+
+        // Draw the frame's cells to the plane. Line widths were measured when the
+        // frame was decoded, so centering needs no further text measurement.
+        for (int y = 0; y < frame_height; ++y) {
+            const Cell* cells = frame.row(y);
+            for (int x = 0; x < layout.line_widths[y]; ++x) {
+                if (cells[x].width == 0) {
+                    continue; // Right half of a wide glyph, already drawn.
+                }
+                put_cell(layout.origin_y + y, layout.line_x[y] + x, cells[x]);
+            }
+        }
+    }
+
+    // Render the virtual planes to the terminal
+    render();
+}
+
+void NotcursesRenderer::draw_changes(const Frame& frame, std::span<const CellUpdate> changes) {
+    if (!layout.matches(frame)) {
+        draw_frame(frame);
+        return;
+    }
+    last_frame = &frame;
+    if (changes.empty()) {
+        return;
+    }
+
+    {
+        StageTimer timer(Stage::draw);
+        for (const auto& change : changes) {
+            if (change.cell.width == 0) {
+                continue; // Covered by the wide glyph to its left.
+            }
+            put_cell(layout.origin_y + change.y, layout.line_x[change.y] + change.x, change.cell);
+        }
+    }
+
+    render();
+}
+
+void NotcursesRenderer::render() {
+    StageTimer timer(Stage::render);
+    notcurses_render(nc);
+}
+
+bool NotcursesRenderer::handle_input(std::uint32_t key) {
+    if (key == NCKEY_RESIZE) {
+        handle_resize();
+        return false;
+    }
+    return key == 'q' || key == 'Q';
+}
+
+bool NotcursesRenderer::drain_input() {
+    StageTimer timer(Stage::input);
+    bool quit = false;
+    while (true) {
+        ncinput input;
+        std::uint32_t key = notcurses_get_nblock(nc, &input);
+        if (key == 0 || key == static_cast<std::uint32_t>(-1)) {
+            return quit;
+        }
+        quit = handle_input(key) || quit;
+    }
+}
+
+void NotcursesRenderer::handle_resize() {
+    unsigned int rows, cols;
+    notcurses_refresh(nc, &rows, &cols);
+    if (!fit_plane_to_terminal()) {
+        return;
+    }
+    layout.clear();
+    if (last_frame != nullptr) {
+        draw_frame(*last_frame);
+    } else {
+        render();
+    }
+}
+
+void NotcursesRenderer::wait_for_quit() {
+    while (true) {
+        ncinput input;
+        std::uint32_t key = notcurses_get_blocking(nc, &input);
+        if (key == static_cast<std::uint32_t>(-1) || handle_input(key)) {
+            break;
+        }
+    }
+}
+
+bool NotcursesRenderer::wait_for_quit_until(std::chrono::steady_clock::time_point deadline) {
+    while (true) {
+        if (drain_input()) {
+            return true;
+        }
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return false;
+        }
+        // poll counts whole milliseconds, so the last fraction of a millisecond
+        // is slept precisely instead.
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+        if (timeout.count() == 0) {
+            std::this_thread::sleep_until(deadline);
+            continue;
+        }
+        pollfd fds = {input_fd, POLLIN, 0};
+        poll(&fds, 1, static_cast<int>(timeout.count()));
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef FRAME_NOTCURSES_RENDERER_H
+#define FRAME_NOTCURSES_RENDERER_H
+
+#include "renderer.h"
+#include <notcurses/notcurses.h>
+#include <cstdint>
+#include <string>
+
+struct Cell;
+
+// Draws frames to the terminal through Notcurses.
+class NotcursesRenderer : public Renderer {
+public:
+    // Constructor: Initializes the Notcurses environment.
+    NotcursesRenderer();
+
+    // Destructor: Shuts down the Notcurses environment.
+    ~NotcursesRenderer() override;
+
+    void clear_screen() override;
+    void draw_frame(const Frame& frame) override;
+    void draw_changes(const Frame& frame, std::span<const CellUpdate> changes) override;
+    void wait_for_quit() override;
+    bool wait_for_quit_until(std::chrono::steady_clock::time_point deadline) override;
+    std::uint64_t get_bytes_written() const override;
+
+private:
+    // Resizes the frame plane to the terminal if needed. Returns true if it changed.
+    bool fit_plane_to_terminal();
+
+    // Handles one input event. Returns true if it asks to quit.
+    bool handle_input(std::uint32_t key);
+
+    // Handles every input event that is already queued, without blocking.
+    // Returns true if any of them asks to quit.
+    bool drain_input();
+
+    // Refits the plane after a terminal resize and redraws the last frame at
+    // its new position.
+    void handle_resize();
+
+    void put_cell(int y, int x, const Cell& cell);
+
+    // Sets the plane's colors and style to the cell's, unless they already are.
+    void set_attributes(const Cell& cell);
+
+    // Pushes the planes out to the terminal.
+    void render();
+
+    struct notcurses* nc;
+    struct ncplane* stdplane;
+    struct ncplane* frame_plane; // Lives as long as the renderer, resized with the terminal
+    unsigned int plane_rows;
+    unsigned int plane_cols;
+    int input_fd; // Becomes readable when input (including resize events) is queued
+    const Frame* last_frame = nullptr; // Redrawn on resize; see Renderer
+
+    FrameLayout layout; // Screen layout of the last frame drawn with draw_frame
+    std::string glyph_buffer; // Reused scratch space for encoding one glyph
+
+    // The attributes last set on the frame plane, so runs of cells with the
+    // same colors set them once.
+    bool attributes_known = false;
+    std::uint32_t plane_fg = 0;
+    std::uint32_t plane_bg = 0;
+    std::uint8_t plane_style = 0;
+};
+
+#endif //FRAME_NOTCURSES_RENDERER_H
@@ -0,0 +1,30 @@
+#ifndef FRAME_RANDOM_H
+#define FRAME_RANDOM_H
+
+#include <cstdint>
+
+// Counter-based randomness. Nothing here keeps state: a random value is a pure
+// function of the run's seed and of where it is used (segment, step, row), so
+// frames can be generated in any order, on any thread, and come out the same.
+
+// The SplitMix64 output function: a strong 64-bit bit mixer.
+inline std::uint64_t mix64(std::uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Derives an independent key from a parent key and one more coordinate.
+inline std::uint64_t derive_key(std::uint64_t key, std::uint64_t coordinate) {
+    return mix64(key ^ mix64(coordinate));
+}
+
+// The 32-bit seed for one row of one interpolation step. Columns then draw
+// dissolve_hash(row_seed + x) (see dissolve_kernel.h).
+inline std::uint32_t row_seed(std::uint64_t seed, int segment, int step, int row) {
+    std::uint64_t key = derive_key(derive_key(derive_key(seed, segment), step), row);
+    return static_cast<std::uint32_t>(key >> 32);
+}
+
+#endif //FRAME_RANDOM_H
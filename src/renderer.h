@@ -1,36 +1,64 @@
 #ifndef FRAME_RENDERER_H
 #define FRAME_RENDERER_H
 
-#include <notcurses/notcurses.h>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
 
 // Forward-declare the Frame class to avoid including the full frame.h here.
 // This is a good practice to reduce compilation times.
 class Frame;
+struct CellUpdate;
 
+// Where the lines of the last fully drawn frame were placed on screen.
+// Shared by the rendering backends so they all center frames the same way.
+struct FrameLayout {
+    int origin_y = 0;
+    int origin_x = 0;
+    int frame_width = 0;
+    std::vector<int> line_x;
+    std::vector<int> line_widths;
+
+    // Centers the frame's box on a screen of the given size. Each line keeps
+    // the offset the frame cached for it, so no text is measured here.
+    void compute(const Frame& frame, int screen_rows, int screen_cols);
+
+    // Checks that the frame would be laid out exactly as the one last computed.
+    bool matches(const Frame& frame) const;
+
+    void clear();
+};
+
+// The drawing interface used by the playback loops. Backends decide where the
+// cells end up: a real terminal, or memory for benchmarks and tests.
+//
+// The last frame drawn must stay alive until the next draw call, so a backend
+// can redraw it when the screen is resized while playback is waiting.
 class Renderer {
 public:
-    // Constructor: Initializes the Notcurses environment.
-    Renderer();
-
-    // Destructor: Shuts down the Notcurses environment.
-    ~Renderer();
+    virtual ~Renderer() = default;
 
     // Clears the entire screen.
-    void clear_screen();
+    virtual void clear_screen() = 0;
 
     // Draws a single frame, centered on the screen.
-    void draw_frame(const Frame& frame);
-    
-    // Waits until the user presses the Notcurses quit key ('q').
-    void wait_for_quit();
-
-    // Checks for 'q' or 'Q' input without blocking. Returns true if quit was requested.
-    bool check_for_quit();
-
-private:
-    struct notcurses* nc;
-    struct ncplane* stdplane;
-    struct ncplane* frame_plane;
+    virtual void draw_frame(const Frame& frame) = 0;
+
+    // Updates only the given cells of a frame that was previously drawn with
+    // draw_frame. Falls back to a full redraw if the screen was resized or the
+    // frame's layout no longer matches what is on screen.
+    virtual void draw_changes(const Frame& frame, std::span<const CellUpdate> changes) = 0;
+
+    // Waits until the user presses the quit key ('q').
+    virtual void wait_for_quit() = 0;
+
+    // Sleeps until `deadline`, handling input and resizes as they arrive rather
+    // than polling. Returns true, as soon as it happens, if quit was requested.
+    virtual bool wait_for_quit_until(std::chrono::steady_clock::time_point deadline) = 0;
+
+    // Bytes sent to the terminal so far, or 0 if the backend cannot tell.
+    virtual std::uint64_t get_bytes_written() const { return 0; }
 };
 
 #endif //FRAME_RENDERER_H
@@ -0,0 +1,81 @@
+#include "scheduler.h"
+#include <ostream>
+#include <stdexcept>
+
+LatePolicy parse_late_policy(const std::string& name) {
+    if (name == "catchup") {
+        return LatePolicy::catch_up;
+    }
+    if (name == "skip") {
+        return LatePolicy::skip;
+    }
+    if (name == "reset") {
+        return LatePolicy::reset;
+    }
+    throw std::runtime_error("Unknown late policy '" + name + "'");
+}
+
+void TimingStats::print(std::ostream& out) const {
+    using std::chrono::duration;
+    double mean_ms = presented > 0 ? duration<double, std::milli>(total_jitter).count() / presented : 0.0;
+    out << "frames presented: " << presented << "\n"
+        << "frames late:      " << late << "\n"
+        << "frames dropped:   " << dropped << "\n"
+        << "jitter mean:      " << mean_ms << " ms\n"
+        << "jitter max:       " << duration<double, std::milli>(max_jitter).count() << " ms\n";
+    if (output_bytes > 0) {
+        out << "output bytes:     " << output_bytes << " (" << (presented > 0 ? output_bytes / presented : 0)
+            << " per frame)\n";
+    }
+}
+
+FrameScheduler::FrameScheduler(int frame_rate, LatePolicy policy) : policy(policy) {
+    set_frame_rate(frame_rate);
+}
+
+void FrameScheduler::set_frame_rate(int frame_rate) {
+    period = std::chrono::nanoseconds(1'000'000'000) / (frame_rate > 0 ? frame_rate : 1);
+}
+
+void FrameScheduler::start() {
+    deadline = clock::now();
+}
+
+bool FrameScheduler::should_drop() {
+    if (policy != LatePolicy::skip) {
+        return false;
+    }
+    auto behind = clock::now() - deadline;
+    if (drop_budget == 0 && behind >= period) {
+        drop_budget = behind / period;
+    }
+    return drop_budget > 0;
+}
+
+void FrameScheduler::drop(std::chrono::nanoseconds hold) {
+    --drop_budget;
+    ++stats.dropped;
+    deadline += period + hold;
+}
+
+void FrameScheduler::presented(std::chrono::nanoseconds hold) {
+    auto now = clock::now();
+    auto jitter = std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline);
+    if (jitter < std::chrono::nanoseconds(0)) {
+        jitter = std::chrono::nanoseconds(0);
+    }
+    ++stats.presented;
+    stats.total_jitter += jitter;
+    if (jitter > stats.max_jitter) {
+        stats.max_jitter = jitter;
+    }
+    if (jitter > period / 2) {
+        ++stats.late;
+    }
+    drop_budget = 0;
+
+    if (policy == LatePolicy::reset && jitter >= period) {
+        deadline = now;
+    }
+    deadline += period + hold;
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// What to do when playback falls behind its schedule.
+enum class LatePolicy {
+    catch_up, // Show every frame, back to back, until the schedule is met again
+    skip,     // Drop frames whose time slot has already passed
+    reset,    // Show the late frame and restart the schedule from now
+};
+
+// Parses "catchup", "skip" or "reset". Throws std::runtime_error otherwise.
+LatePolicy parse_late_policy(const std::string& name);
+
+struct TimingStats {
+    std::uint64_t presented = 0;
+    std::uint64_t late = 0;    // Shown more than half a frame after their deadline
+    std::uint64_t dropped = 0; // Skipped under the skip policy
+    std::chrono::nanoseconds total_jitter{0};
+    std::chrono::nanoseconds max_jitter{0};
+    std::uint64_t output_bytes = 0; // Sent to the terminal, when the renderer can tell
+
+    void print(std::ostream& out) const;
+};
+
+// Paces playback against absolute deadlines. Frame n is due at start + n
+// periods (plus any pauses so far), so sleep overshoot and slow frames never
+// accumulate into drift.
+class FrameScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    FrameScheduler(int frame_rate, LatePolicy policy);
+
+    // Anchors the schedule: the first frame is due now.
+    void start();
+
+    // Changes the rate for the frames that follow. Call start() to re-anchor.
+    void set_frame_rate(int frame_rate);
+
+    // Under the skip policy, true when the current frame's slot is already over
+    // and it should be dropped instead of shown. Drops are limited to the number
+    // of slots that were missed, so a frame is still shown now and then even
+    // when generation is permanently too slow.
+    bool should_drop();
+
+    // Records a dropped frame and moves to the next deadline.
+    void drop(std::chrono::nanoseconds hold);
+
+    // When the current frame is due. The caller does the waiting, so it can
+    // handle input while it sleeps.
+    clock::time_point get_deadline() const { return deadline; }
+
+    // Records a shown frame and moves to the next deadline, `hold` later than usual.
+    void presented(std::chrono::nanoseconds hold);
+
+    // The time left until the current frame is due (zero or negative if late).
+    std::chrono::nanoseconds time_until_due() const { return deadline - clock::now(); }
+
+    const TimingStats& get_stats() const { return stats; }
+
+private:
+    std::chrono::nanoseconds period;
+    LatePolicy policy;
+    clock::time_point deadline;
+    std::int64_t drop_budget = 0;
+    TimingStats stats;
+};
+
+#endif //FRAME_SCHEDULER_H
@@ -0,0 +1,147 @@
+#include "sequencer.h"
+#include "config.h"
+#include "frame_pipeline.h"
+#include "frame_store.h"
+#include "random.h"
+#include "stage_stats.h"
+#include <stdexcept>
+
+namespace {
+
+// Keyframe interval for stored segments. Short, so a segment replayed in
+// reverse decodes only a few deltas per step.
+constexpr int kSegmentKeyframeInterval = 8;
+
+} // namespace
+
+Sequencer::Sequencer(const Animator& animator, const Config& config)
+    : animator(animator),
+      total_steps(config.steps),
+      loop(config.loop),
+      stable_dissolve(config.dissolve == "stable"),
+      pause_duration(config.pause_ms),
+      loop_pause_duration(config.loop_pause_ms),
+      default_transition(parse_transition(config.transition)),
+      memoize(config.memoize) {
+    if (config.dissolve != "random" && config.dissolve != "stable") {
+        throw std::runtime_error("Unknown dissolve style '" + config.dissolve + "'");
+    }
+    for (const auto& name : config.segment_transitions) {
+        segment_transitions.push_back(parse_transition(name));
+    }
+    if (animator.get_frame_count() < 2) {
+        throw std::runtime_error("Animation modes require at least two frames.");
+    }
+}
+
+Sequencer::~Sequencer() = default;
+
+void Sequencer::begin_segment(Transition transition) {
+    segment_key = {start_frame->get_content_hash(), end_frame->get_content_hash(), transition};
+    auto matches = [&](const StoredSegment& stored, const Frame& start, const Frame& end) {
+        return stored.start->has_same_content(start) && stored.end->has_same_content(end);
+    };
+    auto found = segments.find(segment_key);
+    replay_reversed = false;
+    if (found != segments.end() && !matches(found->second, *start_frame, *end_frame)) {
+        found = segments.end();
+    }
+    if (found == segments.end() && (transition == Transition::dissolve || transition == Transition::morph)) {
+        found = segments.find({segment_key.end, segment_key.start, transition});
+        replay_reversed = true;
+        if (found != segments.end() && !matches(found->second, *end_frame, *start_frame)) {
+            found = segments.end();
+        }
+    }
+    if (found != segments.end()) {
+        replay = &found->second;
+        replay->used = true;
+    } else {
+        recording = std::make_unique<FrameStore>(kSegmentKeyframeInterval);
+    }
+}
+
+bool Sequencer::next(Tick& tick) {
+    if (finished) {
+        return false;
+    }
+
+    Transition transition = transition_for(segment);
+    if (step == 0) {
+        // Drop the old segment's dissolve before its frames are released.
+        dissolve.reset();
+        start_frame = animator.get_frame(segment);
+        end_frame = animator.get_frame(segment + 1);
+        if (memoize) {
+            begin_segment(transition);
+        }
+    }
+
+    StageTimer timer(Stage::generate);
+    if (replay != nullptr && !replay_reversed) {
+        tick.full = replay->steps->advance(step, replay_frame, tick.changes);
+        tick.frame = &replay_frame;
+    } else if (replay != nullptr) {
+        replay->steps->decode(total_steps - step, replay_frame);
+        tick.frame = &replay_frame;
+        tick.full = true;
+        tick.changes = {};
+    } else if (stable_dissolve && transition == Transition::dissolve) {
+        if (step == 0) {
+            dissolve.emplace(*start_frame, *end_frame, derive_key(animator.get_seed(), segment));
+        }
+        const auto& changes = dissolve->advance(step, total_steps);
+        // A new segment starts from a different frame, so it is drawn in full
+        // once; after that only the flipped cells are reported.
+        tick.frame = &dissolve->current();
+        tick.full = (step == 0);
+        tick.changes = changes;
+    } else {
+        generated = animator.generate_interpolated_frame(*start_frame, *end_frame, step, total_steps, segment, transition);
+        tick.frame = &generated;
+        tick.full = true;
+        tick.changes = {};
+    }
+    tick.hold = std::chrono::milliseconds(0);
+    if (recording) {
+        recording->append(*tick.frame);
+    }
+
+    // Move the playhead, handling the pause between interpolations and between loops.
+    if (++step > total_steps) {
+        if (recording) {
+            recording->finish();
+            segments[segment_key] = {start_frame, end_frame, std::move(recording)};
+        }
+        replay = nullptr;
+        step = 0;
+        if (segment < animator.get_frame_count() - 2) {
+            tick.hold = pause_duration;
+            ++segment;
+        } else if (loop) {
+            tick.hold = loop_pause_duration;
+            segment = 0;
+            // Segments not played this pass belong to frames whose files have
+            // since changed; drop them.
+            std::erase_if(segments, [](const auto& entry) { return !entry.second.used; });
+            for (auto& entry : segments) {
+                entry.second.used = false;
+            }
+        } else {
+            finished = true;
+        }
+    }
+
+    return true;
+}
+
+Transition Sequencer::transition_for(int index) const {
+    return index < static_cast<int>(segment_transitions.size()) ? segment_transitions[index] : default_transition;
+}
+
+std::unique_ptr<TickSource> make_tick_source(const Animator& animator, const Config& config) {
+    if (config.pipeline_depth > 0) {
+        return std::make_unique<FramePipeline>(animator, config, config.pipeline_depth);
+    }
+    return std::make_unique<Sequencer>(animator, config);
+}
@@ -0,0 +1,111 @@
+#ifndef FRAME_SEQUENCER_H
+#define FRAME_SEQUENCER_H
+
+#include "animator.h"
+#include "frame.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct Config;
+class FrameStore;
+
+// One frame of playback, as handed from the sequencer to a renderer.
+struct Tick {
+    // The complete frame to show. Owned by the sequencer and valid until the next call.
+    const Frame* frame = nullptr;
+    // True when the frame must be drawn in full rather than through `changes`.
+    bool full = true;
+    // Cells changed since the previous tick.
+    std::span<const CellUpdate> changes;
+    // Extra pause after this frame (between segments or before looping).
+    std::chrono::milliseconds hold{0};
+};
+
+// Anything that can hand out ticks one after another.
+class TickSource {
+public:
+    virtual ~TickSource() = default;
+
+    // Produces the next frame. Returns false once a non-looping animation has ended.
+    virtual bool next(Tick& tick) = 0;
+};
+
+// Walks an animation segment by segment (F1->F2, F2->F3, etc.) and step by step,
+// producing the frames to show. It knows nothing about timing or terminals, so the
+// same sequence can be played live, benchmarked, or written out.
+class Sequencer : public TickSource {
+public:
+    Sequencer(const Animator& animator, const Config& config);
+    ~Sequencer() override;
+
+    bool next(Tick& tick) override;
+
+private:
+    const Animator& animator;
+    int total_steps;
+    bool loop;
+    bool stable_dissolve;
+    std::chrono::milliseconds pause_duration;
+    std::chrono::milliseconds loop_pause_duration;
+    Transition default_transition;
+    std::vector<Transition> segment_transitions; // Overrides for the first few segments
+
+    // The effect used for the transition out of frame `index`.
+    Transition transition_for(int index) const;
+
+    int segment = 0;
+    int step = 0;
+    bool finished = false;
+
+    // With `memoize`, every segment is kept once it has been generated and
+    // replayed whenever the same two frames meet again with the same effect.
+    // Effects that look the same run backwards (dissolve, morph) also replay
+    // a stored B->A segment in reverse for A->B. Frames are told apart by
+    // content, since a keyframe store or stream decodes a new copy of a frame
+    // every time it is asked for.
+    struct SegmentKey {
+        std::uint64_t start; // Content hashes of the two frames
+        std::uint64_t end;
+        Transition transition;
+
+        auto operator<=>(const SegmentKey&) const = default;
+    };
+    struct StoredSegment {
+        std::shared_ptr<const Frame> start; // Compared on lookup, in case two frames share a hash
+        std::shared_ptr<const Frame> end;
+        std::unique_ptr<FrameStore> steps;
+        bool used = true; // Played during the current pass
+    };
+
+    // Looks up the current segment, setting `replay` and `replay_reversed`,
+    // or starts recording it.
+    void begin_segment(Transition transition);
+
+    bool memoize;
+    std::map<SegmentKey, StoredSegment> segments;
+    StoredSegment* replay = nullptr;
+    bool replay_reversed = false;
+    Frame replay_frame;                    // The frame on screen while replaying
+    std::unique_ptr<FrameStore> recording; // The segment being generated
+
+    // The two frames of the current segment, held so they stay loaded while in use.
+    std::shared_ptr<const Frame> start_frame;
+    std::shared_ptr<const Frame> end_frame;
+    SegmentKey segment_key{}; // Set with `memoize`
+
+    // The stable dissolve keeps its state for the whole segment.
+    std::optional<Dissolve> dissolve;
+    // Every other effect builds a fresh frame on every step.
+    Frame generated;
+};
+
+// Creates the tick source for a run: the sequencer itself, or a pipeline that
+// runs it on a worker thread when `pipeline_depth` is set.
+std::unique_ptr<TickSource> make_tick_source(const Animator& animator, const Config& config);
+
+#endif //FRAME_SEQUENCER_H
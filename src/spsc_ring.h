@@ -0,0 +1,83 @@
+#ifndef FRAME_SPSC_RING_H
+#define FRAME_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A bounded single-producer/single-consumer ring of preallocated slots. Slots
+// are filled and read in place, so their buffers are reused from lap to lap.
+// The indices are lock-free; a side only sleeps (on a C++20 atomic wait) when
+// the ring is full or empty.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity > 0 ? capacity : 1) {}
+
+    // Producer: returns the next free slot, blocking while the ring is full.
+    // Returns null once the ring has been closed.
+    T* acquire_write() {
+        size_t h = head.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t seen = events.load(std::memory_order_acquire);
+            if (closed.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            if (h - tail.load(std::memory_order_acquire) < slots.size()) {
+                return &slots[h % slots.size()];
+            }
+            events.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // Producer: publishes the slot returned by acquire_write.
+    void commit_write() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        signal();
+    }
+
+    // Consumer: returns the oldest published slot, blocking while the ring is empty.
+    // Returns null once the ring has been closed.
+    T* acquire_read() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t seen = events.load(std::memory_order_acquire);
+            if (closed.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            if (head.load(std::memory_order_acquire) != t) {
+                return &slots[t % slots.size()];
+            }
+            events.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // Consumer: hands the slot returned by acquire_read back to the producer.
+    void release_read() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        signal();
+    }
+
+    // Wakes both sides and makes every further acquire return null.
+    void close() {
+        closed.store(true, std::memory_order_release);
+        signal();
+    }
+
+private:
+    // Every state change bumps the event counter, so a waiter that read the
+    // counter before checking the ring can never miss the wakeup.
+    void signal() {
+        events.fetch_add(1, std::memory_order_acq_rel);
+        events.notify_all();
+    }
+
+    std::vector<T> slots;
+    alignas(64) std::atomic<size_t> head{0}; // Next slot to write, owned by the producer
+    alignas(64) std::atomic<size_t> tail{0}; // Next slot to read, owned by the consumer
+    alignas(64) std::atomic<uint32_t> events{0};
+    std::atomic<bool> closed{false};
+};
+
+#endif //FRAME_SPSC_RING_H
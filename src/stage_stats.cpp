@@ -0,0 +1,132 @@
+#include "stage_stats.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+namespace {
+
+std::atomic<bool> stats_enabled{false};
+std::array<LatencyHistogram, kStageCount> histograms;
+
+double to_us(std::chrono::nanoseconds t) {
+    return static_cast<double>(t.count()) / 1000.0;
+}
+
+} // namespace
+
+const char* stage_name(Stage stage) {
+    switch (stage) {
+    case Stage::load: return "load";
+    case Stage::generate: return "generate";
+    case Stage::draw: return "draw";
+    case Stage::render: return "render";
+    case Stage::input: return "input";
+    }
+    return "unknown";
+}
+
+int LatencyHistogram::bucket_of(std::uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<int>(value);
+    }
+    // The top kSubBits + 1 bits pick the bucket: the leading one sets the
+    // power of two, the bits after it the sub-bucket within it.
+    int msb = std::bit_width(value) - 1;
+    int shift = msb - kSubBits;
+    int sub = static_cast<int>(value >> shift) - kSubBuckets;
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::bucket_upper_bound(int bucket) {
+    if (bucket < kSubBuckets) {
+        return static_cast<std::uint64_t>(bucket);
+    }
+    int shift = bucket / kSubBuckets - 1;
+    std::uint64_t sub = static_cast<std::uint64_t>(bucket % kSubBuckets + kSubBuckets);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+    auto value = static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count(), 0));
+    buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t seen = largest.load(std::memory_order_relaxed);
+    while (value > seen && !largest.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double q) const {
+    std::uint64_t samples = count();
+    if (samples == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    auto rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(samples)));
+    rank = std::max<std::uint64_t>(rank, 1);
+    std::uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // The bucket's bound can overshoot the largest sample; never report past it.
+            auto bound = std::min(bucket_upper_bound(i), static_cast<std::uint64_t>(max().count()));
+            return std::chrono::nanoseconds(bound);
+        }
+    }
+    return max();
+}
+
+void enable_stage_stats() {
+    stats_enabled.store(true, std::memory_order_relaxed);
+}
+
+bool stage_stats_enabled() {
+    return stats_enabled.load(std::memory_order_relaxed);
+}
+
+LatencyHistogram& stage_histogram(Stage stage) {
+    return histograms[static_cast<int>(stage)];
+}
+
+void print_stage_stats(std::ostream& out) {
+    out << "stage           count      p50 us      p99 us      max us\n";
+    auto flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    for (int i = 0; i < kStageCount; ++i) {
+        auto stage = static_cast<Stage>(i);
+        const LatencyHistogram& histogram = stage_histogram(stage);
+        if (histogram.count() == 0) {
+            continue;
+        }
+        out << std::left << std::setw(10) << stage_name(stage) << std::right
+            << std::setw(11) << histogram.count()
+            << std::setw(12) << to_us(histogram.percentile(0.50))
+            << std::setw(12) << to_us(histogram.percentile(0.99))
+            << std::setw(12) << to_us(histogram.max()) << "\n";
+    }
+    out.flags(flags);
+}
+
+void write_stats_json(std::ostream& out, const TimingStats& timing) {
+    auto mean_jitter = timing.presented > 0 ? timing.total_jitter.count() / static_cast<std::int64_t>(timing.presented) : 0;
+    out << "{\n"
+        << "  \"frames_presented\": " << timing.presented << ",\n"
+        << "  \"frames_late\": " << timing.late << ",\n"
+        << "  \"frames_dropped\": " << timing.dropped << ",\n"
+        << "  \"jitter_mean_ns\": " << mean_jitter << ",\n"
+        << "  \"jitter_max_ns\": " << timing.max_jitter.count() << ",\n"
+        << "  \"output_bytes\": " << timing.output_bytes << ",\n"
+        << "  \"output_bytes_per_frame\": " << (timing.presented > 0 ? timing.output_bytes / timing.presented : 0) << ",\n"
+        << "  \"stages\": {";
+    for (int i = 0; i < kStageCount; ++i) {
+        auto stage = static_cast<Stage>(i);
+        const LatencyHistogram& histogram = stage_histogram(stage);
+        out << (i > 0 ? "," : "") << "\n    \"" << stage_name(stage) << "\": {"
+            << "\"count\": " << histogram.count()
+            << ", \"p50_ns\": " << histogram.percentile(0.50).count()
+            << ", \"p99_ns\": " << histogram.percentile(0.99).count()
+            << ", \"max_ns\": " << histogram.max().count() << "}";
+    }
+    out << "\n  }\n}\n";
+}
@@ -0,0 +1,87 @@
+#ifndef FRAME_STAGE_STATS_H
+#define FRAME_STAGE_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+struct TimingStats;
+
+// The parts of the hot path that are timed separately.
+enum class Stage {
+    load,     // Reading and decoding one frame file
+    generate, // Producing the next frame (interpolation or dissolve step)
+    draw,     // Putting a frame's cells onto the screen plane
+    render,   // Pushing the plane out to the terminal
+    input,    // Polling for a quit key
+};
+
+constexpr int kStageCount = 5;
+
+const char* stage_name(Stage stage);
+
+// A fixed-size, lock-free latency histogram. Buckets are log-linear: sixteen
+// per power of two, so any recorded value is reported within about 6%.
+// Recording is a few relaxed atomic adds and is safe from any thread.
+class LatencyHistogram {
+public:
+    void record(std::chrono::nanoseconds latency);
+
+    std::uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(largest.load(std::memory_order_relaxed)); }
+
+    // Returns the latency below which a fraction `q` (0..1) of the samples fall.
+    std::chrono::nanoseconds percentile(double q) const;
+
+private:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    static int bucket_of(std::uint64_t value);
+    static std::uint64_t bucket_upper_bound(int bucket);
+
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> largest{0};
+};
+
+// Stage timing is off until enabled, so runs without --stats pay one relaxed
+// load per timed section and no clock reads.
+void enable_stage_stats();
+bool stage_stats_enabled();
+
+LatencyHistogram& stage_histogram(Stage stage);
+
+// Times the enclosing scope into a stage's histogram.
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage) : stage(stage), enabled(stage_stats_enabled()) {
+        if (enabled) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~StageTimer() {
+        if (enabled) {
+            stage_histogram(stage).record(std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stage stage;
+    bool enabled;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Prints count, p50, p99 and max for every stage that recorded anything.
+void print_stage_stats(std::ostream& out);
+
+// Writes the frame timing and every stage's histogram summary as one JSON object.
+void write_stats_json(std::ostream& out, const TimingStats& timing);
+
+#endif //FRAME_STAGE_STATS_H
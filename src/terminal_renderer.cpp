@@ -0,0 +1,222 @@
+#include "terminal_renderer.h"
+#include "frame.h"
+#include "stage_stats.h"
+#include <cerrno>
+#include <csignal>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>     // For fcntl
+#include <poll.h>      // For poll
+#include <sys/ioctl.h> // For the terminal size
+#include <unistd.h>    // For read, write, pipe
+
+namespace {
+
+constexpr const char* kEnterAltScreen = "\x1b[?1049h";
+constexpr const char* kLeaveAltScreen = "\x1b[?1049l";
+// What the destructor leaves behind, for a process that is killed instead.
+constexpr const char* kRestoreScreen = "\x1b[m\x1b[?25h\x1b[?1049l";
+constexpr char kCtrlC = '\x03';
+
+// Signals that end the process, and their actions from before the renderer.
+constexpr int kTerminatingSignals[] = {SIGTERM, SIGHUP};
+struct sigaction saved_terminate_actions[std::size(kTerminatingSignals)] = {};
+struct termios terminate_termios = {};
+
+// The write end of the resize pipe, for the signal handler.
+int resize_signal_fd = -1;
+struct sigaction saved_winch_action = {};
+
+void on_resize(int) {
+    int saved_errno = errno;
+    char byte = 0;
+    static_cast<void>(write(resize_signal_fd, &byte, 1));
+    errno = saved_errno;
+}
+
+// Gives the terminal back, then lets the signal end the process as it would have.
+void on_terminate(int signal) {
+    static_cast<void>(write(STDOUT_FILENO, kRestoreScreen, std::char_traits<char>::length(kRestoreScreen)));
+    tcsetattr(STDIN_FILENO, TCSANOW, &terminate_termios);
+    for (size_t i = 0; i < std::size(kTerminatingSignals); ++i) {
+        if (kTerminatingSignals[i] == signal) {
+            sigaction(signal, &saved_terminate_actions[i], nullptr);
+        }
+    }
+    raise(signal);
+}
+
+void terminal_size(int& rows, int& cols) {
+    struct winsize size = {};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row;
+        cols = size.ws_col;
+    } else {
+        rows = 24;
+        cols = 80;
+    }
+}
+
+void write_all(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // The terminal is gone; nothing more can be shown.
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+} // namespace
+
+TerminalRenderer::TerminalRenderer() : encoder(0, 0) {
+    if (!isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &saved_termios) != 0) {
+        throw std::runtime_error("The ANSI renderer needs a terminal on standard input and output.");
+    }
+    // Without ISIG, Ctrl-C arrives as a key and quits through the destructor.
+    struct termios raw = saved_termios;
+    raw.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO | ISIG);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+
+    terminate_termios = saved_termios;
+    for (size_t i = 0; i < std::size(kTerminatingSignals); ++i) {
+        struct sigaction action = {};
+        action.sa_handler = on_terminate;
+        sigemptyset(&action.sa_mask);
+        sigaction(kTerminatingSignals[i], &action, &saved_terminate_actions[i]);
+    }
+
+    // Resizes arrive as a signal; the handler wakes up waits through a pipe.
+    if (pipe(resize_pipe) == 0) {
+        for (int fd : resize_pipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        resize_signal_fd = resize_pipe[1];
+        struct sigaction action = {};
+        action.sa_handler = on_resize;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &action, &saved_winch_action);
+    }
+
+    int rows, cols;
+    terminal_size(rows, cols);
+    encoder.resize(rows, cols);
+    write_all(kEnterAltScreen, std::char_traits<char>::length(kEnterAltScreen));
+}
+
+TerminalRenderer::~TerminalRenderer() {
+    encoder.finish();
+    flush();
+    write_all(kLeaveAltScreen, std::char_traits<char>::length(kLeaveAltScreen));
+    if (resize_pipe[0] >= 0) {
+        sigaction(SIGWINCH, &saved_winch_action, nullptr);
+        resize_signal_fd = -1;
+        close(resize_pipe[0]);
+        close(resize_pipe[1]);
+    }
+    for (size_t i = 0; i < std::size(kTerminatingSignals); ++i) {
+        sigaction(kTerminatingSignals[i], &saved_terminate_actions[i], nullptr);
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+}
+
+void TerminalRenderer::flush() {
+    const std::string& output = encoder.get_output();
+    if (output.empty()) {
+        return;
+    }
+    StageTimer timer(Stage::render);
+    write_all(output.data(), output.size());
+    bytes_written += output.size();
+    encoder.clear_output();
+}
+
+void TerminalRenderer::clear_screen() {
+    encoder.clear_screen();
+    flush();
+}
+
+void TerminalRenderer::draw_frame(const Frame& frame) {
+    last_frame = &frame;
+    encoder.draw_frame(frame);
+    flush();
+}
+
+void TerminalRenderer::draw_changes(const Frame& frame, std::span<const CellUpdate> changes) {
+    last_frame = &frame;
+    encoder.draw_changes(frame, changes);
+    flush();
+}
+
+void TerminalRenderer::handle_resize() {
+    char drained[64];
+    while (read(resize_pipe[0], drained, sizeof(drained)) > 0) {
+    }
+    int rows, cols;
+    terminal_size(rows, cols);
+    if (rows == encoder.get_rows() && cols == encoder.get_cols()) {
+        return;
+    }
+    encoder.resize(rows, cols);
+    encoder.clear_screen();
+    if (last_frame != nullptr) {
+        encoder.draw_frame(*last_frame);
+    }
+    flush();
+}
+
+bool TerminalRenderer::read_input() {
+    StageTimer timer(Stage::input);
+    char keys[64];
+    ssize_t count;
+    while ((count = read(STDIN_FILENO, keys, sizeof(keys))) > 0) {
+        for (ssize_t i = 0; i < count; ++i) {
+            if (keys[i] == 'q' || keys[i] == 'Q' || keys[i] == kCtrlC) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TerminalRenderer::wait_for_events(int timeout_ms) {
+    pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {resize_pipe[0], POLLIN, 0}};
+    if (poll(fds, resize_pipe[0] >= 0 ? 2 : 1, timeout_ms) > 0 && (fds[1].revents & POLLIN)) {
+        handle_resize();
+    }
+}
+
+void TerminalRenderer::wait_for_quit() {
+    while (!read_input()) {
+        wait_for_events(-1);
+    }
+}
+
+bool TerminalRenderer::wait_for_quit_until(std::chrono::steady_clock::time_point deadline) {
+    while (true) {
+        if (read_input()) {
+            return true;
+        }
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return false;
+        }
+        // poll counts whole milliseconds, so the last fraction of a millisecond
+        // is slept precisely instead.
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+        if (timeout.count() == 0) {
+            std::this_thread::sleep_until(deadline);
+            continue;
+        }
+        wait_for_events(static_cast<int>(timeout.count()));
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef FRAME_TERMINAL_RENDERER_H
+#define FRAME_TERMINAL_RENDERER_H
+
+#include "ansi_renderer.h"
+#include "renderer.h"
+#include <cstdint>
+#include <termios.h>
+
+// Draws frames to the terminal with plain ANSI escape sequences and no
+// Notcurses, for serial consoles and small boards where every byte and system
+// call counts. An AnsiRenderer keeps the front buffer (what the terminal
+// shows) and builds each frame's smallest update in a preallocated buffer,
+// which goes out in a single write.
+class TerminalRenderer : public Renderer {
+public:
+    // Takes over the terminal on standard input and output: unbuffered input
+    // without echo, the alternate screen and a hidden cursor. Ctrl-C quits
+    // like 'q', and SIGTERM or SIGHUP give the terminal back before the
+    // process ends. Throws std::runtime_error if standard output is not a terminal.
+    TerminalRenderer();
+
+    // Gives the terminal back as it was.
+    ~TerminalRenderer() override;
+
+    TerminalRenderer(const TerminalRenderer&) = delete;
+    TerminalRenderer& operator=(const TerminalRenderer&) = delete;
+
+    void clear_screen() override;
+    void draw_frame(const Frame& frame) override;
+    void draw_changes(const Frame& frame, std::span<const CellUpdate> changes) override;
+    void wait_for_quit() override;
+    bool wait_for_quit_until(std::chrono::steady_clock::time_point deadline) override;
+    std::uint64_t get_bytes_written() const override { return bytes_written; }
+
+private:
+    // Writes everything encoded since the last flush in one go.
+    void flush();
+
+    // Reads the keys already typed. Returns true if one of them asks to quit.
+    bool read_input();
+
+    // Fits the screen to the terminal's new size and redraws the last frame.
+    void handle_resize();
+
+    // Waits up to `timeout_ms` (-1 for ever) for a key or a resize, and
+    // handles a resize if there was one.
+    void wait_for_events(int timeout_ms);
+
+    AnsiRenderer encoder;
+    struct termios saved_termios = {};
+    int resize_pipe[2] = {-1, -1}; // Written by the SIGWINCH handler to wake up waits
+    const Frame* last_frame = nullptr; // Redrawn on resize; see Renderer
+    std::uint64_t bytes_written = 0;
+};
+
+#endif //FRAME_TERMINAL_RENDERER_H
@@ -0,0 +1,51 @@
+#ifndef FRAME_THREAD_POOL_H
+#define FRAME_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for splitting independent work items (frame
+// files, frame rows) across cores. The calling thread takes part in the work.
+class ThreadPool {
+public:
+    // `threads` counts the calling thread too, so 1 means no extra workers.
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls body(i) for every i in [0, count) and returns once all calls are done.
+    // Calls run concurrently and in no particular order. One job runs at a time.
+    void parallel_for(size_t count, const std::function<void(size_t)>& body);
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+    void worker_loop();
+    void run_items();
+
+    std::vector<std::thread> workers;
+    std::mutex submit_mutex; // Serializes callers of parallel_for
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* job = nullptr;
+    size_t job_count = 0;
+    std::atomic<size_t> next_index{0};
+    unsigned busy = 0;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// Turns a configured thread count into a real one: 0 means one per core.
+unsigned resolve_thread_count(int configured);
+
+#endif //FRAME_THREAD_POOL_H
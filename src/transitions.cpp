@@ -0,0 +1,308 @@
+#include "transitions.h"
+#include "dissolve_kernel.h"
+#include "random.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// Walks a row unit by unit, copying each unit from the end line if
+// `take_end(x)` holds for its first column and from the start line otherwise.
+template <class TakeEnd>
+void choose_units(const LineView& start, const LineView& end, Cell* out, int x, int line_width, TakeEnd take_end) {
+    while (x < line_width) {
+        int span = unit_span(start, end, x, line_width);
+        const LineView& source = take_end(x) ? end : start;
+        for (int i = x; i < x + span; ++i) {
+            out[i] = source.at(i);
+        }
+        x += span;
+    }
+}
+
+// The templated driver shared by every effect. A policy provides
+//
+//     void fill_row(int y, const LineView& start, const LineView& end, Cell* out, int line_width) const;
+//
+// which writes one row of the result; whatever it needs per frame is worked
+// out once in its constructor. Rows are independent, so large frames are split
+// into blocks of rows across the thread pool.
+template <class Policy>
+Frame run_transition(const Frame& start, const Frame& end, const Policy& policy, ThreadPool& pool) {
+    // The new frame is large enough to hold either of the two source frames.
+    int width = std::max(start.get_width(), end.get_width());
+    int height = std::max(start.get_height(), end.get_height());
+    Frame result(width, height);
+
+    auto fill = [&](int y) {
+        // If one frame is shorter, its missing lines are empty.
+        LineView start_line = line_view(start, y);
+        LineView end_line = line_view(end, y);
+        int line_width = std::max(start_line.width, end_line.width);
+        result.set_line_width(y, line_width);
+        policy.fill_row(y, start_line, end_line, result.row(y), line_width);
+    };
+
+    constexpr int kRowsPerBlock = 16;
+    constexpr long kMinCellsForThreads = 32 * 1024;
+    if (pool.size() > 1 && static_cast<long>(width) * height >= kMinCellsForThreads) {
+        int blocks = (height + kRowsPerBlock - 1) / kRowsPerBlock;
+        pool.parallel_for(blocks, [&](size_t block) {
+            int first = static_cast<int>(block) * kRowsPerBlock;
+            int last = std::min(first + kRowsPerBlock, height);
+            for (int y = first; y < last; ++y) {
+                fill(y);
+            }
+        });
+    } else {
+        for (int y = 0; y < height; ++y) {
+            fill(y);
+        }
+    }
+    return result;
+}
+
+// Each column draws a random value from its row's seed; the probability of
+// choosing the end glyph increases with progress.
+class DissolvePolicy {
+public:
+    DissolvePolicy(const Frame& start, const Frame& end, const TransitionStep& step)
+        : step(step),
+          start_height(start.get_height()),
+          end_height(end.get_height()),
+          kernel_width(std::min(start.get_width(), end.get_width())) {
+        // Without wide glyphs every column switches on its own, so whole rows can go
+        // through the vectorized kernel. The threshold is progress scaled to 2^32.
+        float progress = step.progress();
+        single_width = !start.has_wide_glyphs() && !end.has_wide_glyphs();
+        all_end = progress >= 1.0f;
+        threshold = static_cast<std::uint32_t>(std::max(progress, 0.0f) * 4294967296.0);
+    }
+
+    void fill_row(int y, const LineView& start, const LineView& end, Cell* out, int line_width) const {
+        std::uint32_t seed_for_row = row_seed(step.seed, step.segment, step.step, y);
+
+        int x = 0;
+        if (single_width && !all_end && y < start_height && y < end_height) {
+            // Both rows are padded out to their frame's width, so the kernel can
+            // run over the columns that exist in both; the rest fall back to blanks.
+            x = std::min(line_width, kernel_width);
+            dissolve_row(start.cells, end.cells, out, x, seed_for_row, threshold);
+        }
+
+        // The remaining columns go unit by unit. A wide glyph's unit switches
+        // on the random draw of its first column.
+        choose_units(start, end, out, x, line_width, [&](int column) {
+            return all_end || dissolve_hash(seed_for_row + static_cast<std::uint32_t>(column)) < threshold;
+        });
+    }
+
+private:
+    TransitionStep step;
+    int start_height;
+    int end_height;
+    int kernel_width;
+    bool single_width;
+    bool all_end;
+    std::uint32_t threshold;
+};
+
+// A boundary moves across each line; columns left of it show the end frame.
+class WipeHorizontalPolicy {
+public:
+    explicit WipeHorizontalPolicy(float progress) : progress(progress) {}
+
+    void fill_row(int, const LineView& start, const LineView& end, Cell* out, int line_width) const {
+        int edge = static_cast<int>(progress * static_cast<float>(line_width));
+        choose_units(start, end, out, 0, line_width, [edge](int column) { return column < edge; });
+    }
+
+private:
+    float progress;
+};
+
+// A boundary moves down the frame; rows above it show the end frame.
+class WipeVerticalPolicy {
+public:
+    WipeVerticalPolicy(float progress, int height)
+        : edge(static_cast<int>(progress * static_cast<float>(height))) {}
+
+    void fill_row(int y, const LineView& start, const LineView& end, Cell* out, int line_width) const {
+        const LineView& source = y < edge ? end : start;
+        for (int x = 0; x < line_width; ++x) {
+            out[x] = source.at(x);
+        }
+    }
+
+private:
+    int edge;
+};
+
+// The end line enters from the right while the start line leaves to the left.
+class SlidePolicy {
+public:
+    explicit SlidePolicy(float progress) : progress(progress) {}
+
+    void fill_row(int, const LineView& start, const LineView& end, Cell* out, int line_width) const {
+        int shift = static_cast<int>(std::lround(progress * static_cast<float>(line_width)));
+        int split = line_width - shift;
+        for (int x = 0; x < split; ++x) {
+            out[x] = start.at(x + shift);
+        }
+        for (int x = split; x < line_width; ++x) {
+            out[x] = end.at(x - split);
+        }
+
+        // A wide glyph cut in half at either edge of the seam cannot be shown.
+        blank_split_wide_glyphs(out, line_width);
+    }
+
+private:
+    float progress;
+};
+
+// Printable ASCII grouped by roughly how much of the cell each glyph inks,
+// from empty to solid. Glyphs not listed count as medium.
+constexpr std::string_view kInkLevels[] = {
+    " ",
+    ".,'`",
+    ":;-_^\"~",
+    "!|/\\()[]{}<>ir+=lIjtc1?",
+    "*sxvzfnueaT7Jy",
+    "oLCYkhdbpqgw2345Z",
+    "OAEFPUVX069SGKRNHD",
+    "mQ#%&8$",
+    "MWB@",
+};
+constexpr int kInkLevelCount = static_cast<int>(std::size(kInkLevels));
+constexpr std::uint8_t kDefaultInkLevel = 4;
+
+// One glyph per ink level, used for the in-between steps of a morph.
+constexpr char kInkRamp[] = " .:+*oO#@";
+static_assert(sizeof(kInkRamp) - 1 == kInkLevelCount);
+
+constexpr std::array<std::uint8_t, 128> make_ink_table() {
+    std::array<std::uint8_t, 128> table{};
+    for (auto& level : table) {
+        level = kDefaultInkLevel;
+    }
+    for (int level = 0; level < kInkLevelCount; ++level) {
+        for (char c : kInkLevels[level]) {
+            table[static_cast<unsigned char>(c)] = static_cast<std::uint8_t>(level);
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::uint8_t, 128> kInkTable = make_ink_table();
+
+int ink_level(char32_t glyph) {
+    return glyph < kInkTable.size() ? kInkTable[glyph] : kDefaultInkLevel;
+}
+
+// Each cell steps through the ink ramp from its start glyph's coverage to its
+// end glyph's, while its colors blend from the start cell's to the end cell's.
+// Units holding a wide glyph switch whole at the halfway point.
+class MorphPolicy {
+public:
+    explicit MorphPolicy(float progress)
+        : progress(progress), weight(static_cast<std::uint32_t>(std::clamp(progress, 0.0f, 1.0f) * 256.0f)) {}
+
+    void fill_row(int, const LineView& start, const LineView& end, Cell* out, int line_width) const {
+        for (int x = 0; x < line_width;) {
+            int span = unit_span(start, end, x, line_width);
+            const Cell& from = start.at(x);
+            const Cell& to = end.at(x);
+            if (span == 1 && from.width == 1 && to.width == 1) {
+                out[x] = morph(from, to);
+            } else {
+                const LineView& source = progress >= 0.5f ? end : start;
+                for (int i = x; i < x + span; ++i) {
+                    out[i] = source.at(i);
+                }
+            }
+            x += span;
+        }
+    }
+
+private:
+    Cell morph(const Cell& from, const Cell& to) const {
+        if (progress <= 0.0f || from == to) {
+            return from;
+        }
+        if (progress >= 1.0f) {
+            return to;
+        }
+        Cell cell = morph_glyph(from, to);
+        cell.fg = blend_color(from.fg, to.fg, weight);
+        cell.bg = blend_color(from.bg, to.bg, weight);
+        return cell;
+    }
+
+    // The glyph and style for this step, before colors are blended.
+    Cell morph_glyph(const Cell& from, const Cell& to) const {
+        int from_level = ink_level(from.glyph);
+        int to_level = ink_level(to.glyph);
+        if (from_level == to_level) {
+            return progress < 0.5f ? from : to;
+        }
+        int level = from_level + static_cast<int>(std::lround(static_cast<float>(to_level - from_level) * progress));
+        if (level == from_level) {
+            return from;
+        }
+        if (level == to_level) {
+            return to;
+        }
+        Cell cell = progress < 0.5f ? from : to;
+        cell.glyph = static_cast<char32_t>(kInkRamp[level]);
+        return cell;
+    }
+
+    float progress;
+    std::uint32_t weight; // Progress out of 256, for blend_color
+};
+
+} // namespace
+
+Transition parse_transition(const std::string& name) {
+    if (name == "dissolve") {
+        return Transition::dissolve;
+    }
+    if (name == "wipe_h") {
+        return Transition::wipe_horizontal;
+    }
+    if (name == "wipe_v") {
+        return Transition::wipe_vertical;
+    }
+    if (name == "slide") {
+        return Transition::slide;
+    }
+    if (name == "morph") {
+        return Transition::morph;
+    }
+    throw std::runtime_error("Unknown transition '" + name + "'");
+}
+
+Frame interpolate_frames(Transition transition, const Frame& start, const Frame& end,
+                         const TransitionStep& step, ThreadPool& pool) {
+    float progress = step.progress();
+    switch (transition) {
+    case Transition::dissolve:
+        break;
+    case Transition::wipe_horizontal:
+        return run_transition(start, end, WipeHorizontalPolicy(progress), pool);
+    case Transition::wipe_vertical: {
+        int height = std::max(start.get_height(), end.get_height());
+        return run_transition(start, end, WipeVerticalPolicy(progress, height), pool);
+    }
+    case Transition::slide:
+        return run_transition(start, end, SlidePolicy(progress), pool);
+    case Transition::morph:
+        return run_transition(start, end, MorphPolicy(progress), pool);
+    }
+    return run_transition(start, end, DissolvePolicy(start, end, step), pool);
+}
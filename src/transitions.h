@@ -0,0 +1,71 @@
+#ifndef FRAME_TRANSITIONS_H
+#define FRAME_TRANSITIONS_H
+
+#include "frame.h"
+#include <cstdint>
+#include <string>
+
+class ThreadPool;
+
+// The effects available for a segment's transition from one frame to the next.
+enum class Transition {
+    dissolve,        // Cells switch at random as progress grows
+    wipe_horizontal, // A boundary sweeps each line from left to right
+    wipe_vertical,   // A boundary sweeps the frame from top to bottom
+    slide,           // The end frame pushes the start frame out to the left
+    morph,           // Cells step through glyphs ordered by ink coverage
+};
+
+// Parses "dissolve", "wipe_h", "wipe_v", "slide" or "morph".
+// Throws std::runtime_error for anything else.
+Transition parse_transition(const std::string& name);
+
+// Where an interpolated frame sits in the animation.
+struct TransitionStep {
+    std::uint64_t seed = 0; // The run's seed, for effects with random choices
+    int segment = 0;
+    int step = 0;
+    int total_steps = 0;
+
+    // Progress from 0.0 (fully start frame) to 1.0 (fully end frame).
+    float progress() const {
+        return total_steps == 0 ? 1.0f : static_cast<float>(step) / total_steps;
+    }
+};
+
+// Builds one frame of a transition. Each effect is a policy type run through a
+// templated row driver, so its per-cell work is inlined and the effect is only
+// chosen once per frame. Rows are split across `pool` for large frames.
+Frame interpolate_frames(Transition transition, const Frame& start, const Frame& end,
+                         const TransitionStep& step, ThreadPool& pool);
+
+// One line of a source frame, as seen by the transitions.
+struct LineView {
+    const Cell* cells = nullptr;
+    int width = 0;
+
+    // Returns the cell at column x, or a blank past the end of the line.
+    const Cell& at(int x) const {
+        return x < width ? cells[x] : kBlankCell;
+    }
+};
+
+inline LineView line_view(const Frame& frame, int y) {
+    if (y >= frame.get_height()) {
+        return {};
+    }
+    return {frame.row(y), frame.get_line_width(y)};
+}
+
+// Returns how many columns, starting at x, must be taken from the same frame:
+// one column plus any covered by a wide glyph in either line, so that the two
+// halves of a wide glyph are never split between the start and end frames.
+inline int unit_span(const LineView& a, const LineView& b, int x, int limit) {
+    int end = x + 1;
+    while (end < limit && (a.at(end).width == 0 || b.at(end).width == 0)) {
+        ++end;
+    }
+    return end - x;
+}
+
+#endif //FRAME_TRANSITIONS_H